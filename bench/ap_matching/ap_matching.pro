@@ -0,0 +1,23 @@
+QT -= gui
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+# Compares phase correlation and block matching of alignment points
+# on a synthetic image shifted by known subpixel amounts
+
+SOURCES += \
+    main.cpp \
+    ../../source/core/stacking/ap_correlator.cpp \
+    ../../source/core/stacking/block_matcher.cpp \
+    ../../source/core/stacking/phase_correlator.cpp
+
+INCLUDEPATH += \
+    ../../source \
+    ../../source/core
+
+win32:CONFIG(release, debug|release): LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110
+else:win32:CONFIG(debug, debug|release): LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110d
+else:unix: LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110
+INCLUDEPATH += C:/libs/opencv/build/include
+DEPENDPATH += C:/libs/opencv/build/include
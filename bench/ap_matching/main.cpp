@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+#include "stacking/ap_correlator.h"
+
+//
+// Times local alignment of one frame's APs, per AP size, by phase
+// correlation and by block matching, and measures their error against
+// known subpixel shifts. cv::phaseCorrelate is run as a reference.
+//
+
+namespace {
+
+constexpr int imageSize = 1024;
+constexpr int frames = 16;
+constexpr int radius = 4;
+
+cv::Mat texture() {
+    cv::Mat noise(imageSize, imageSize, CV_32F);
+    cv::RNG rng(1);
+    rng.fill(noise, cv::RNG::UNIFORM, 0.0, 1.0);
+    cv::GaussianBlur(noise, noise, cv::Size(), 2.0);
+    cv::normalize(noise, noise, 0.0, 1.0, cv::NORM_MINMAX);
+    return noise;
+}
+
+cv::Mat shifted(const cv::Mat &image, cv::Point2f shift) {
+    cv::Mat transform = (cv::Mat_<double>(2, 3) << 1, 0, shift.x, 0, 1, shift.y);
+    cv::Mat result;
+    cv::warpAffine(image, result, transform, image.size(), cv::INTER_CUBIC, cv::BORDER_REFLECT);
+    return result;
+}
+
+std::vector<cv::Rect> grid(int size) {
+    std::vector<cv::Rect> regions;
+    for (int y = 64; y + size <= imageSize - 64; y += 2 * size) {
+        for (int x = 64; x + size <= imageSize - 64; x += 2 * size) {
+            regions.emplace_back(x, y, size, size);
+        }
+    }
+    return regions;
+}
+
+struct Score {
+    double micros = 0.0;
+    double squared = 0.0;
+    int count = 0;
+    int missed = 0;
+};
+
+void add(Score &score, cv::Point2f found, double response, cv::Point2f expected) {
+    if (response <= 0.0) {
+        ++score.missed;
+        return;
+    }
+    cv::Point2f error = found - expected;
+    score.squared += error.dot(error);
+    ++score.count;
+}
+
+void print(const char *name, const Score &score, int aps) {
+    double rms = score.count > 0 ? std::sqrt(score.squared / score.count) : 0.0;
+    std::printf("    %-16s %8.2f us/AP  rms %.3f px  missed %d\n",
+                name, score.micros / (static_cast<double>(aps) * frames), rms, score.missed);
+}
+
+} // namespace
+
+int main() {
+    using Clock = std::chrono::steady_clock;
+
+    const cv::Mat reference = texture();
+    cv::RNG rng(2);
+    std::vector<cv::Mat> images;
+    std::vector<cv::Point2f> expected;
+    for (int i = 0; i < frames; ++i) {
+        // A frame shifted by s has the reference content at p + s
+        cv::Point2f shift(rng.uniform(-radius + 0.5f, radius - 0.5f), rng.uniform(-radius + 0.5f, radius - 0.5f));
+        images.push_back(shifted(reference, shift));
+        expected.push_back(shift);
+    }
+
+    for (int size : {16, 24, 32, 48, 64}) {
+        std::vector<cv::Rect> regions = grid(size);
+        const int aps = static_cast<int>(regions.size());
+        std::vector<int> points(aps);
+        for (int i = 0; i < aps; ++i) {
+            points[i] = i;
+        }
+        std::vector<cv::Point> offsets(aps, {0, 0});
+
+        std::printf("AP %dx%d, %d APs, automatic choice: %s\n", size, size, aps,
+                    BlockMatcher::preferred({size, size}, radius) ? "block matching" : "phase correlation");
+
+        for (LocalAlignment method : {LocalAlignment::PhaseCorrelation, LocalAlignment::BlockMatching}) {
+            ApCorrelator correlator(reference, regions, method, radius);
+            std::vector<ApCorrelator::Result> results;
+            Score score;
+            for (int f = 0; f < frames; ++f) {
+                auto start = Clock::now();
+                correlator.correlate(images[f], points, offsets, 0.0, results);
+                score.micros += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                for (const ApCorrelator::Result &result : results) {
+                    add(score, result.shift, result.response, expected[f]);
+                }
+            }
+            print(method == LocalAlignment::PhaseCorrelation ? "phase correlation" : "block matching", score, aps);
+        }
+
+        cv::Mat window;
+        cv::createHanningWindow(window, {size, size}, CV_32F);
+        Score score;
+        for (int f = 0; f < frames; ++f) {
+            auto start = Clock::now();
+            std::vector<cv::Point2f> found(aps);
+            std::vector<double> responses(aps);
+            for (int i = 0; i < aps; ++i) {
+                found[i] = cv::phaseCorrelate(reference(regions[i]), images[f](regions[i]), window, &responses[i]);
+            }
+            score.micros += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            for (int i = 0; i < aps; ++i) {
+                add(score, found[i], responses[i], expected[f]);
+            }
+        }
+        print("cv::phaseCorrelate", score, aps);
+    }
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+#include "components/frame.h"
+#include "components/quality_metrics.h"
+
+//
+// Times every metric of the registry per frame, on synthetic 8-bit frames
+// of typical capture sizes, the way analysis evaluates them: one metric
+// selected at a time, on luminance downscaled by half.
+//
+// Then compares the ranking of Frame::estimateQuality with the one of the
+// separate-pass pipeline it replaced, on shifted and blurred frames of even
+// and odd sizes, like object windows have.
+//
+
+namespace {
+
+constexpr int repeats = 20;
+constexpr double scale = 0.5;
+
+//
+// Returns a planet-like frame: a textured disk on a dark, noisy background.
+//
+cv::Mat syntheticFrame(cv::Size size, cv::RNG &rng) {
+    cv::Mat texture(size, CV_32F);
+    rng.fill(texture, cv::RNG::UNIFORM, 0.0, 1.0);
+    cv::GaussianBlur(texture, texture, cv::Size(), 3.0);
+    cv::normalize(texture, texture, 0.0, 1.0, cv::NORM_MINMAX);
+
+    cv::Mat disk = cv::Mat::zeros(size, CV_32F);
+    cv::circle(disk, {size.width / 2, size.height / 2}, std::min(size.width, size.height) / 3, cv::Scalar(1.0), cv::FILLED, cv::LINE_AA);
+    cv::GaussianBlur(disk, disk, cv::Size(), 2.0);
+
+    cv::Mat noise(size, CV_32F);
+    rng.fill(noise, cv::RNG::NORMAL, 0.0, 0.02);
+
+    cv::Mat frame;
+    cv::Mat(disk.mul(0.4 + 0.5 * texture) + noise).convertTo(frame, CV_8U, 255.0);
+    return frame;
+}
+
+//
+// Frame::estimateQuality before its stages were fused: area downscale,
+// Gaussian blur and Sobel gradients as separate full-frame passes, with
+// 8-bit intermediates.
+//
+double previousQuality(const cv::Mat &gray, double scale) {
+    cv::Mat reduced;
+    cv::resize(gray, reduced, cv::Size(), scale, scale, cv::INTER_AREA);
+    cv::GaussianBlur(reduced, reduced, cv::Size(3, 3), 0.5);
+
+    cv::Mat gradX, gradY;
+    cv::Sobel(reduced, gradX, CV_64F, 1, 0, 3);
+    cv::Sobel(reduced, gradY, CV_64F, 0, 1, 3);
+
+    cv::Mat magnitude, capped;
+    cv::magnitude(gradX, gradY, magnitude);
+    cv::threshold(magnitude, capped, 200.0, 200.0, cv::THRESH_TRUNC);
+    return cv::mean(capped)[0];
+}
+
+//
+// Returns the number of pairs of frames that 'a' and 'b' order differently.
+//
+int discordantPairs(const std::vector<double> &a, const std::vector<double> &b) {
+    int count = 0;
+    for (int i = 0; i < a.size(); ++i) {
+        for (int j = i + 1; j < a.size(); ++j) {
+            if ((a[i] - a[j]) * (b[i] - b[j]) < 0.0) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+//
+// Scores a capture of 'frames' frames of 'size' with both pipelines: the
+// same scene, shifted by subpixel amounts and blurred by varying seeing.
+//
+void compareRanking(cv::Size size, int frames, cv::RNG &rng) {
+    const cv::Mat scene = syntheticFrame(size, rng);
+
+    std::vector<double> previous, fused;
+    double maxDifference = 0.0;
+    for (int i = 0; i < frames; ++i) {
+        cv::Mat transform = (cv::Mat_<double>(2, 3) << 1, 0, rng.uniform(-3.0, 3.0), 0, 1, rng.uniform(-3.0, 3.0));
+        cv::Mat frame;
+        cv::warpAffine(scene, frame, transform, size, cv::INTER_CUBIC, cv::BORDER_REFLECT);
+        cv::GaussianBlur(frame, frame, cv::Size(), rng.uniform(0.5, 3.0));
+
+        previous.push_back(previousQuality(frame, scale));
+        fused.push_back(Frame::estimateQuality(frame, scale));
+        maxDifference = std::max(maxDifference, std::abs(fused.back() - previous.back()) / std::max(previous.back(), 1e-9));
+    }
+
+    int discordant = discordantPairs(previous, fused);
+    std::printf("    %4dx%-4d  max score difference %.3f%%  discordant pairs %d of %d%s\n",
+                size.width, size.height, 100.0 * maxDifference, discordant, frames * (frames - 1) / 2,
+                discordant == 0 ? "" : "  RANKING DIFFERS");
+}
+
+} // namespace
+
+int main() {
+    using Clock = std::chrono::steady_clock;
+
+    const auto &registry = QualityMetrics::registry();
+    cv::RNG rng(1);
+
+    for (cv::Size size : {cv::Size(640, 480), cv::Size(1280, 960), cv::Size(1920, 1080), cv::Size(3096, 2080)}) {
+        const cv::Mat frame = syntheticFrame(size, rng);
+        std::printf("%dx%d\n", size.width, size.height);
+
+        for (int metric = 0; metric < registry.size(); ++metric) {
+            QualityMetrics metrics({metric});
+            std::vector<double> scores;
+
+            // Warm up caches and allocations
+            metrics.evaluate(frame, scale, scores);
+
+            auto start = Clock::now();
+            for (int i = 0; i < repeats; ++i) {
+                metrics.evaluate(frame, scale, scores);
+            }
+            double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+
+            std::printf("    %-20s %8.3f ms per frame\n", registry[metric].name.toUtf8().constData(), milliseconds);
+        }
+    }
+
+    std::printf("Ranking of the fused sharpness kernel against the previous pipeline\n");
+    for (cv::Size size : {cv::Size(640, 480), cv::Size(641, 481), cv::Size(333, 257), cv::Size(1920, 1080)}) {
+        compareRanking(size, 100, rng);
+    }
+
+    return 0;
+}
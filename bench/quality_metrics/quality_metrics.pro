@@ -0,0 +1,23 @@
+QT -= gui
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+# Times every registered frame quality metric on synthetic frames
+# of typical capture sizes
+
+SOURCES += \
+    main.cpp \
+    ../../source/core/components/bayer.cpp \
+    ../../source/core/components/frame.cpp \
+    ../../source/core/components/quality_metrics.cpp
+
+INCLUDEPATH += \
+    ../../source \
+    ../../source/core
+
+win32:CONFIG(release, debug|release): LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110
+else:win32:CONFIG(debug, debug|release): LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110d
+else:unix: LIBS += -LC:/libs/opencv/build/x64/vc16/lib/ -lopencv_world4110
+INCLUDEPATH += C:/libs/opencv/build/include
+DEPENDPATH += C:/libs/opencv/build/include
@@ -3,16 +3,31 @@ QT += widgets core gui
 CONFIG += c++20
 
 SOURCES += \
+    source/core/components/bayer.cpp \
     source/core/components/display.cpp \
     source/core/components/frame.cpp \
+    source/core/components/quality_metrics.cpp \
+    source/core/data/analysis_cache.cpp \
+    source/core/data/avi_file.cpp \
+    source/core/data/fits_file.cpp \
+    source/core/data/frame_cache.cpp \
+    source/core/data/frame_index.cpp \
+    source/core/data/frame_stream.cpp \
+    source/core/data/image_sequence.cpp \
     source/core/data/media_collection.cpp \
     source/core/data/media_file.cpp \
+    source/core/data/ser_file.cpp \
     source/core/processing/color_correction.cpp \
     source/core/processing/deconvolution.cpp \
     source/core/processing/image_processor.cpp \
     source/core/processing/wavelets.cpp \
     source/core/stacking/alignment.cpp \
+    source/core/stacking/ap_correlator.cpp \
+    source/core/stacking/block_matcher.cpp \
+    source/core/stacking/phase_correlator.cpp \
+    source/core/stacking/pyramid_correlator.cpp \
     source/core/stacking/stacker.cpp \
+    source/core/stacking/tracker.cpp \
     source/threading/analyze_thread.cpp \
     source/threading/stack_thread.cpp \
     source/ui/dialogs/deconvolution_dialog/deconvolution_dialog.cpp \
@@ -24,24 +39,37 @@ SOURCES += \
     source/ui/widgets/process_page/process_page.cpp \
     source/main.cpp \
     source/ui/widgets/stack_page/stack_page.cpp \
-    source/ui/widgets/stack_page/threads/sort_thread.cpp \
     source/ui/workspace.cpp
 
 HEADERS += \
+    source/core/components/bayer.h \
     source/core/components/display.h \
     source/core/components/frame.h \
+    source/core/components/quality_metrics.h \
+    source/core/data/analysis_cache.h \
+    source/core/data/avi_file.h \
+    source/core/data/fits_file.h \
+    source/core/data/frame_cache.h \
+    source/core/data/frame_index.h \
+    source/core/data/frame_stream.h \
+    source/core/data/image_sequence.h \
     source/core/data/media_collection.h \
     source/core/data/media_file.h \
+    source/core/data/ser_file.h \
     source/core/processing/color_correction.h \
     source/core/processing/deconvolution.h \
     source/core/processing/image_processor.h \
     source/core/processing/wavelets.h \
     source/core/stacking/alignment.h \
+    source/core/stacking/ap_correlator.h \
+    source/core/stacking/block_matcher.h \
+    source/core/stacking/phase_correlator.h \
+    source/core/stacking/pyramid_correlator.h \
     source/core/stacking/stacker.h \
+    source/core/stacking/tracker.h \
     source/threading/analyze_thread.h \
     source/threading/stack_thread.h \
     source/threading/thread.h \
-    source/threading/thread_pool.h \
     source/ui/dialogs/deconvolution_dialog/deconvolution_dialog.h \
     source/ui/dialogs/deconvolution_dialog/image_viewer.h \
     source/ui/dialogs/rgb_align_dialog/rgb_align_dialog.h \
@@ -50,7 +78,6 @@ HEADERS += \
     source/ui/widgets/main_window/main_window.h \
     source/ui/widgets/process_page/process_page.h \
     source/ui/widgets/stack_page/stack_page.h \
-    source/ui/widgets/stack_page/threads/sort_thread.h \
     source/ui/workspace.h \
 
 FORMS += \
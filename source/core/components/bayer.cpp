@@ -0,0 +1,94 @@
+#include "bayer.h"
+
+//
+// Returns the pattern named by 'name' (e.g. the BAYERPAT card of a FITS file),
+// or Pattern::None if it isn't a known Bayer pattern.
+//
+Bayer::Pattern Bayer::patternFromName(const QString &name) {
+    QString upper = name.trimmed().toUpper();
+    if (upper == "RGGB") {
+        return Pattern::RGGB;
+    }
+    if (upper == "GRBG") {
+        return Pattern::GRBG;
+    }
+    if (upper == "GBRG") {
+        return Pattern::GBRG;
+    }
+    if (upper == "BGGR") {
+        return Pattern::BGGR;
+    }
+    return Pattern::None;
+}
+
+//
+// Interpolates the mosaic 'raw' to a full resolution BGR image, written into 'buffer'.
+//
+// 'buffer' is reused as long as its size and type match, so a thread debayering
+// many frames allocates only once. Frames without a pattern are returned as they are.
+// Float data has no OpenCV debayering kernels and goes through 16-bit.
+//
+cv::Mat Bayer::debayer(const cv::Mat &raw, Pattern pattern, Method method, cv::Mat &buffer) {
+    if (pattern == Pattern::None || raw.channels() != 1) {
+        return raw;
+    }
+
+    // OpenCV names patterns after the second row's second and third pixels
+    int code;
+    switch (pattern) {
+    case Pattern::RGGB:
+        code = method == Method::EdgeAware ? cv::COLOR_BayerBG2BGR_EA : cv::COLOR_BayerBG2BGR;
+        break;
+    case Pattern::GRBG:
+        code = method == Method::EdgeAware ? cv::COLOR_BayerGB2BGR_EA : cv::COLOR_BayerGB2BGR;
+        break;
+    case Pattern::GBRG:
+        code = method == Method::EdgeAware ? cv::COLOR_BayerGR2BGR_EA : cv::COLOR_BayerGR2BGR;
+        break;
+    default:
+        code = method == Method::EdgeAware ? cv::COLOR_BayerRG2BGR_EA : cv::COLOR_BayerRG2BGR;
+        break;
+    }
+
+    if (raw.depth() == CV_32F) {
+        cv::Mat raw16U;
+        raw.convertTo(raw16U, CV_16U, 65535.0);
+        cv::cvtColor(raw16U, buffer, code);
+    }
+    else {
+        cv::cvtColor(raw, buffer, code);
+    }
+
+    return buffer;
+}
+
+//
+// Returns the green channel of the mosaic 'raw' at half width and height,
+// averaging the two green samples of every 2x2 cell.
+//
+// Green carries most of the luminance, so this is a cheap stand-in for
+// the gray image of the debayered frame at a quarter of the pixels.
+// Frames without a pattern are returned as they are.
+//
+cv::Mat Bayer::green(const cv::Mat &raw, Pattern pattern) {
+    if (pattern == Pattern::None || raw.channels() != 1 || raw.rows < 2 || raw.cols < 2) {
+        return raw;
+    }
+
+    // Even and odd rows viewed as two-channel (even column, odd column) images
+    const int type = CV_MAKETYPE(raw.depth(), 2);
+    cv::Mat evenRows(raw.rows / 2, raw.cols / 2, type, const_cast<uchar *>(raw.ptr(0)), raw.step * 2);
+    cv::Mat oddRows(raw.rows / 2, raw.cols / 2, type, const_cast<uchar *>(raw.ptr(1)), raw.step * 2);
+
+    // Greens sit on the anti-diagonal of RGGB and BGGR cells, and on the diagonal otherwise
+    bool antiDiagonal = pattern == Pattern::RGGB || pattern == Pattern::BGGR;
+
+    cv::Mat first, second;
+    cv::extractChannel(evenRows, first, antiDiagonal ? 1 : 0);
+    cv::extractChannel(oddRows, second, antiDiagonal ? 0 : 1);
+
+    cv::Mat green;
+    cv::addWeighted(first, 0.5, second, 0.5, 0.0, green);
+
+    return green;
+}
@@ -0,0 +1,30 @@
+#ifndef BAYER_H
+#define BAYER_H
+
+#include <opencv2/opencv.hpp>
+#include <QString>
+
+// Color filter array helpers for raw captures of one-shot color cameras.
+//
+// Patterns are named after the top-left 2x2 cell of the sensor.
+class Bayer {
+public:
+    enum class Pattern {
+        None,
+        RGGB,
+        GRBG,
+        GBRG,
+        BGGR
+    };
+
+    enum class Method {
+        Bilinear,  // Fastest, slight zippering along sharp edges
+        EdgeAware  // Interpolates along edges, a few times slower
+    };
+
+    static Pattern patternFromName(const QString &name);
+    static cv::Mat debayer(const cv::Mat &raw, Pattern pattern, Method method, cv::Mat &buffer);
+    static cv::Mat green(const cv::Mat &raw, Pattern pattern);
+};
+
+#endif // BAYER_H
@@ -1,10 +1,11 @@
 #include "display.h"
+#include "components/frame.h"
 
 void Display::show(const cv::Mat &mat, Qt::AspectRatioMode mode) {
     cv::Mat displayMat;
 
-    if (mat.depth() == CV_32F) {
-        mat.convertTo(displayMat, CV_8U, 255.0);
+    if (mat.depth() != CV_8U) {
+        mat.convertTo(displayMat, CV_8U, Frame::to8BitScale(mat.depth()));
     }
     else {
         displayMat = mat.clone();
@@ -1,51 +1,151 @@
 #include "frame.h"
+#include <opencv2/core/hal/intrin.hpp>
 
 //
-// Centers an object in 'frame' by detecting the largest contour and
-// adjusting a bounding rectangle to 'width' and 'height'.
+// Thresholded intensity sums of 8-bit 'gray' in one pass: every pixel weighs
+// its excess over 'threshold', summed per row into 'rowSums' and per column
+// into 'colSums'. All moments and the bounding box follow from the two.
 //
-// If the rectangle extends beyond the frame boundaries, out-of-bounds areas
-// are filled with black.
+static void thresholdedSums(const cv::Mat &gray, uchar threshold, std::vector<int> &rowSums, std::vector<int> &colSums) {
+    rowSums.assign(gray.rows, 0);
+    colSums.assign(gray.cols, 0);
+    int *columns = colSums.data();
+
+    for (int y = 0; y < gray.rows; ++y) {
+        const uchar *row = gray.ptr<uchar>(y);
+        unsigned rowSum = 0;
+        int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+        const int quarter = cv::VTraits<cv::v_int32>::vlanes();
+        const cv::v_uint8 vThreshold = cv::vx_setall_u8(threshold);
+        cv::v_uint32 vRowSum = cv::vx_setzero_u32();
+        for (; x + lanes <= gray.cols; x += lanes) {
+            // Saturating, pixels below the threshold weigh nothing
+            cv::v_uint8 weights = cv::v_sub(cv::vx_load(row + x), vThreshold);
+
+            cv::v_uint16 low, high;
+            cv::v_expand(weights, low, high);
+            cv::v_uint32 w[4];
+            cv::v_expand(low, w[0], w[1]);
+            cv::v_expand(high, w[2], w[3]);
+
+            for (int i = 0; i < 4; ++i) {
+                int *column = columns + x + i * quarter;
+                cv::v_store(column, cv::v_add(cv::vx_load(column), cv::v_reinterpret_as_s32(w[i])));
+                vRowSum = cv::v_add(vRowSum, w[i]);
+            }
+        }
+        rowSum = cv::v_reduce_sum(vRowSum);
+#endif
+        for (; x < gray.cols; ++x) {
+            int weight = std::max(row[x] - threshold, 0);
+            columns[x] += weight;
+            rowSum += weight;
+        }
+        rowSums[y] = static_cast<int>(rowSum);
+    }
+}
+
+//
+// Returns the first and last index of 'sums' holding at least 2% of
+// the largest sum, which trims noise and the faintest edge of the object.
 //
-cv::Mat Frame::centerObject(cv::Mat frame, int width, int height) {
-    cv::Mat processed;
-    cv::cvtColor(frame, processed, cv::COLOR_BGR2GRAY);
+static std::pair<int, int> significantRange(const std::vector<int> &sums) {
+    const int limit = std::max(1, *std::max_element(sums.begin(), sums.end()) / 50);
+    auto significant = [limit](int sum) { return sum >= limit; };
 
-    // Downscale for faster object detection
-    const double scale = 0.5;
-    cv::resize(processed, processed, {}, scale, scale, cv::INTER_AREA);
+    int first = static_cast<int>(std::find_if(sums.begin(), sums.end(), significant) - sums.begin());
+    int last = static_cast<int>(sums.rend() - std::find_if(sums.rbegin(), sums.rend(), significant)) - 1;
+    return {first, last};
+}
 
-    // Preprocess for contour detection
-    cv::blur(processed, processed, cv::Size(3, 3));
-    processed.convertTo(processed, CV_8U);
-    cv::threshold(processed, processed, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+//
+// Locates the bright object in 'frame'.
+//
+// The background level is an Otsu threshold of every 4th pixel of every
+// 4th row, and the object is what is above it: a single pass over the frame
+// sums the excess per row and per column, giving the intensity centroid
+// (to a fraction of a pixel) and the bounding box.
+//
+Frame::ObjectLocation Frame::locateObject(const cv::Mat &frame) {
+    ObjectLocation location;
+    if (frame.empty()) {
+        return location;
+    }
 
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(processed, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-    if (contours.empty()) {
-        return frame;
+    cv::Mat gray;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        gray = frame;
+    }
+    if (gray.depth() != CV_8U) {
+        gray.convertTo(gray, CV_8U, to8BitScale(gray.depth()));
     }
 
-    // Combine all contours
-    std::vector<cv::Point> allPoints;
-    for (const auto &contour : contours) {
-        allPoints.insert(allPoints.end(), contour.begin(), contour.end());
+    constexpr int stride = 4;
+    cv::Mat sampled;
+    if (gray.cols >= stride && gray.rows >= stride) {
+        cv::resize(gray, sampled, cv::Size(gray.cols / stride, gray.rows / stride), 0, 0, cv::INTER_NEAREST);
     }
+    else {
+        sampled = gray;
+    }
+    cv::Mat binary;
+    const auto threshold = static_cast<uchar>(cv::threshold(sampled, binary, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU));
 
-    // Rectangle for downscaled image
-    cv::Rect rect = cv::boundingRect(allPoints);
-    // Back to original size
-    rect = cv::Rect {rect.tl() * (1.0 / scale), rect.br() * (1.0 / scale)};
+    location.threshold = threshold;
 
-    // Center of the rectangle
-    cv::Point center = (rect.tl() + rect.br()) / 2;
-    // Calculate a rectangle with 'width' and 'height' around center
-    rect = cv::Rect {center.x - width / 2, center.y - height / 2, width, height};
+    std::vector<int> rowSums, colSums;
+    thresholdedSums(gray, threshold, rowSums, colSums);
+
+    double mass = 0.0, xMoment = 0.0, yMoment = 0.0;
+    for (int y = 0; y < rowSums.size(); ++y) {
+        mass += rowSums[y];
+        yMoment += static_cast<double>(y) * rowSums[y];
+    }
+    for (int x = 0; x < colSums.size(); ++x) {
+        xMoment += static_cast<double>(x) * colSums[x];
+    }
+
+    if (mass <= 0.0) {
+        return location;
+    }
+
+    location.center = {xMoment / mass, yMoment / mass};
+
+    auto [top, bottom] = significantRange(rowSums);
+    auto [left, right] = significantRange(colSums);
+    location.bounds = cv::Rect(cv::Point(left, top), cv::Point(right + 1, bottom + 1));
+    location.found = true;
+
+    return location;
+}
+
+//
+// Centers the object of 'frame' (see 'locateObject()') in a 'width' x
+// 'height' rectangle.
+//
+// If the rectangle extends beyond the frame boundaries, out-of-bounds areas
+// are filled with black. Otherwise the result is a copy of that part of
+// 'frame', or a view into it if 'view' is true.
+//
+cv::Mat Frame::centerObject(cv::Mat frame, int width, int height, bool view) {
+    ObjectLocation location = locateObject(frame);
+    if (!location.found) {
+        return frame;
+    }
+
+    // Calculate a rectangle with 'width' and 'height' around the center
+    cv::Point center(cvRound(location.center.x), cvRound(location.center.y));
+    cv::Rect rect{center.x - width / 2, center.y - height / 2, width, height};
 
     // Check for out-of-bounds
     cv::Rect validRect = rect & cv::Rect {0, 0, frame.cols, frame.rows};
     if (validRect.width == rect.width && validRect.height == rect.height) {
-        return frame(validRect).clone();
+        return view ? frame(validRect) : frame(validRect).clone();
     }
 
     // Fill out-of-bounds area with black
@@ -72,6 +172,149 @@ cv::Mat Frame::expandBorders(cv::Mat frame, int width, int height) {
     return bordered;
 }
 
+//
+// Sharpness kernel of 'estimateQuality()': mean of the capped gradient magnitude
+// of the 8-bit image at 'data', after a 'factor' x 'factor' box downscale
+// (1 or 2) and a 3x3 Gaussian blur (sigma 0.5).
+//
+// All stages run row by row over rings of three float rows, so every
+// intermediate result stays in cache and nothing is allocated per stage.
+// Borders are reflected (BORDER_REFLECT_101), as OpenCV filters do.
+// Halving leaves out an odd last row or column, which the area downscale
+// this replaced spread over the last pixels; bench/quality_metrics checks
+// that rankings are unaffected.
+//
+static double cappedGradientMean(const uchar *data, size_t step, int rows, int cols, int factor) {
+    const int width = cols / factor;
+    const int height = rows / factor;
+    if (width < 3 || height < 3) {
+        return 0.0;
+    }
+
+    // Normalized 3-tap Gaussian, sigma = 0.5
+    const float tail = std::exp(-2.0f);
+    const float side = tail / (1.0f + 2.0f * tail);
+    const float center = 1.0f / (1.0f + 2.0f * tail);
+    const float cap = 200.0f;
+
+    std::vector<float> storage(7 * static_cast<size_t>(width));
+    float *down = storage.data();
+    float *horizontal[3], *blurred[3];
+    for (int i = 0; i < 3; ++i) {
+        horizontal[i] = down + (1 + i) * width;
+        blurred[i] = down + (4 + i) * width;
+    }
+
+    auto reflect = [height](int row) {
+        return row < 0 ? -row : (row >= height ? 2 * height - 2 - row : row);
+    };
+
+    // Downscaled and horizontally blurred row 'row'
+    auto computeHorizontal = [&](int row) {
+        const uchar *top = data + step * row * factor;
+        if (factor == 2) {
+            const uchar *bottom = top + step;
+            for (int x = 0; x < width; ++x) {
+                down[x] = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1]) * 0.25f;
+            }
+        }
+        else {
+            for (int x = 0; x < width; ++x) {
+                down[x] = top[x];
+            }
+        }
+
+        float *out = horizontal[row % 3];
+        out[0] = center * down[0] + 2.0f * side * down[1];
+        int x = 1;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        const cv::v_float32 vSide = cv::vx_setall_f32(side), vCenter = cv::vx_setall_f32(center);
+        for (; x + lanes <= width - 1; x += lanes) {
+            cv::v_float32 sum = cv::v_add(cv::vx_load(down + x - 1), cv::vx_load(down + x + 1));
+            cv::v_store(out + x, cv::v_fma(sum, vSide, cv::v_mul(cv::vx_load(down + x), vCenter)));
+        }
+#endif
+        for (; x < width - 1; ++x) {
+            out[x] = side * (down[x - 1] + down[x + 1]) + center * down[x];
+        }
+        out[width - 1] = center * down[width - 1] + 2.0f * side * down[width - 2];
+    };
+
+    // Vertically blurred row 'row', from horizontal rows 'row' - 1 to 'row' + 1
+    auto computeBlurred = [&](int row) {
+        const float *previous = horizontal[reflect(row - 1) % 3];
+        const float *current = horizontal[row % 3];
+        const float *next = horizontal[reflect(row + 1) % 3];
+        float *out = blurred[row % 3];
+        int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        const cv::v_float32 vSide = cv::vx_setall_f32(side), vCenter = cv::vx_setall_f32(center);
+        for (; x + lanes <= width; x += lanes) {
+            cv::v_float32 sum = cv::v_add(cv::vx_load(previous + x), cv::vx_load(next + x));
+            cv::v_store(out + x, cv::v_fma(sum, vSide, cv::v_mul(cv::vx_load(current + x), vCenter)));
+        }
+#endif
+        for (; x < width; ++x) {
+            out[x] = side * (previous[x] + next[x]) + center * current[x];
+        }
+    };
+
+    // Sum of the capped Sobel gradient magnitude of blurred row 'row'
+    auto gradientSum = [&](int row) {
+        const float *p = blurred[reflect(row - 1) % 3];
+        const float *c = blurred[row % 3];
+        const float *n = blurred[reflect(row + 1) % 3];
+
+        auto magnitude = [&](int left, int x, int right) {
+            float gx = (p[right] - p[left]) + 2.0f * (c[right] - c[left]) + (n[right] - n[left]);
+            float gy = (n[left] + 2.0f * n[x] + n[right]) - (p[left] + 2.0f * p[x] + p[right]);
+            return std::min(std::sqrt(gx * gx + gy * gy), cap);
+        };
+
+        float sum = magnitude(1, 0, 1) + magnitude(width - 2, width - 1, width - 2);
+        int x = 1;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+        const cv::v_float32 two = cv::vx_setall_f32(2.0f), vCap = cv::vx_setall_f32(cap);
+        cv::v_float32 vSum = cv::vx_setzero_f32();
+        for (; x + lanes <= width - 1; x += lanes) {
+            cv::v_float32 pl = cv::vx_load(p + x - 1), pc = cv::vx_load(p + x), pr = cv::vx_load(p + x + 1);
+            cv::v_float32 cl = cv::vx_load(c + x - 1), cr = cv::vx_load(c + x + 1);
+            cv::v_float32 nl = cv::vx_load(n + x - 1), nc = cv::vx_load(n + x), nr = cv::vx_load(n + x + 1);
+
+            cv::v_float32 gx = cv::v_add(cv::v_add(cv::v_sub(pr, pl), cv::v_sub(nr, nl)), cv::v_mul(two, cv::v_sub(cr, cl)));
+            cv::v_float32 gy = cv::v_sub(cv::v_fma(two, nc, cv::v_add(nl, nr)), cv::v_fma(two, pc, cv::v_add(pl, pr)));
+            cv::v_float32 magnitudes = cv::v_sqrt(cv::v_fma(gx, gx, cv::v_mul(gy, gy)));
+            vSum = cv::v_add(vSum, cv::v_min(magnitudes, vCap));
+        }
+        sum += cv::v_reduce_sum(vSum);
+#endif
+        for (; x < width - 1; ++x) {
+            sum += magnitude(x - 1, x, x + 1);
+        }
+        return static_cast<double>(sum);
+    };
+
+    // Each stage is one row ahead of the next, which is all the rings hold
+    int horizontalRows = 0, blurredRows = 0;
+    double total = 0.0;
+    for (int y = 0; y < height; ++y) {
+        int neededBlurred = std::min(y + 1, height - 1);
+        for (; blurredRows <= neededBlurred; ++blurredRows) {
+            int neededHorizontal = std::min(blurredRows + 1, height - 1);
+            for (; horizontalRows <= neededHorizontal; ++horizontalRows) {
+                computeHorizontal(horizontalRows);
+            }
+            computeBlurred(blurredRows);
+        }
+        total += gradientSum(y);
+    }
+
+    return total / (static_cast<double>(width) * height);
+}
+
 //
 // Estimates the quality of 'frame' by measuring its sharpness.
 //
@@ -79,7 +322,10 @@ cv::Mat Frame::expandBorders(cv::Mat frame, int width, int height) {
 // where higher values indicate sharper, more detailed images, and lower
 // values suggest blurring.
 //
-double Frame::estimateQuality(cv::Mat frame) {
+// 'frame' is downscaled by 'scale' first, frames that are already reduced
+// (e.g. the green plane of a raw capture) can pass 1.0.
+//
+double Frame::estimateQuality(cv::Mat frame, double scale) {
     // Convert to gray
     cv::Mat gray;
     if (frame.channels() == 3) {
@@ -89,26 +335,93 @@ double Frame::estimateQuality(cv::Mat frame) {
         gray = frame;
     }
 
-    // Downscale to reduce computation
-    const double scale = 0.5;
-    cv::resize(gray, gray, cv::Size(), scale, scale, cv::INTER_AREA);
+    // The capping threshold is defined for 8-bit data
+    if (gray.depth() != CV_8U) {
+        gray.convertTo(gray, CV_8U, to8BitScale(gray.depth()));
+    }
+
+    // Halving is fused into the kernel, other scales need a separate pass
+    int factor = 1;
+    if (scale == 0.5) {
+        factor = 2;
+    }
+    else if (scale != 1.0) {
+        cv::resize(gray, gray, cv::Size(), scale, scale, cv::INTER_AREA);
+    }
+
+    // Downscale, blur, Sobel gradients, capping and mean in a single pass
+    return cappedGradientMean(gray.data, gray.step, gray.rows, gray.cols, factor);
+}
+
+//
+// Returns the brightness-weighted centroid of what is above 'threshold'
+// (see 'locateObject()') in 8-bit 'gray', or (-1, -1) if nothing is.
+//
+// Only every 4th pixel of every 4th row is visited, which is plenty for
+// following an object that covers many pixels.
+//
+cv::Point2f Frame::objectCentroid(const cv::Mat &gray, double threshold) {
+    constexpr int stride = 4;
+    if (gray.cols < stride || gray.rows < stride) {
+        return {-1.0f, -1.0f};
+    }
+
+    cv::Mat sampled;
+    cv::resize(gray, sampled, cv::Size(gray.cols / stride, gray.rows / stride), 0, 0, cv::INTER_NEAREST);
+    cv::threshold(sampled, sampled, threshold, 0, cv::THRESH_TOZERO);
 
-    // Apply blur to reduce noise
-    cv::GaussianBlur(gray, gray, cv::Size(3, 3), 0.5);
+    cv::Moments moments = cv::moments(sampled);
+    if (moments.m00 <= 0.0) {
+        return {-1.0f, -1.0f};
+    }
 
-    // Compute the gradients in the x and y directions using Sobel operators
-    cv::Mat gradX, gradY;
-    cv::Sobel(gray, gradX, CV_64F, 1, 0, 3);
-    cv::Sobel(gray, gradY, CV_64F, 0, 1, 3);
+    return {
+        static_cast<float>(moments.m10 / moments.m00 * stride),
+        static_cast<float>(moments.m01 / moments.m00 * stride)
+    };
+}
 
-    // Calculate the gradient magnitude from the x and y gradients
-    cv::Mat magnitude;
-    cv::magnitude(gradX, gradY, magnitude);
+//
+// Returns the factor that brings values of 'depth' to the 8-bit range.
+//
+// 16-bit data uses its full range, float data is expected in [0, 1].
+//
+double Frame::to8BitScale(int depth) {
+    switch (depth) {
+    case CV_16U:
+        return 255.0 / 65535.0;
+    case CV_32F:
+        return 255.0;
+    default:
+        return 1.0;
+    }
+}
 
-    // Cap the gradient magnitude at 200 to prevent extreme values from dominating
-    cv::Mat capped;
-    cv::threshold(magnitude, capped, 200.0, 200.0, cv::THRESH_TRUNC);
+//
+// Returns the 8-bit luminance of 'frame', converting into 'buffer' if needed.
+//
+// 8-bit mono frames are returned as they are, raw mosaics ('pattern' set)
+// as their green plane at half resolution. Deeper samples are multiplied
+// by 'scale' on the way to 8 bits, see MediaFile::sampleScale().
+//
+cv::Mat Frame::luma(const cv::Mat &frame, Bayer::Pattern pattern, cv::Mat &buffer, int scale) {
+    if (frame.empty()) {
+        return frame;
+    }
+
+    cv::Mat gray;
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, buffer, cv::COLOR_BGR2GRAY);
+        gray = buffer;
+    }
+    else {
+        gray = Bayer::green(frame, pattern);
+    }
+
+    if (gray.depth() != CV_8U) {
+        gray.convertTo(buffer, CV_8U, to8BitScale(gray.depth()) * scale);
+        gray = buffer;
+    }
 
-    // Return the mean of the capped gradient magnitude
-    return cv::mean(capped)[0];
+    return gray;
 }
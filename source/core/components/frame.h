@@ -2,12 +2,25 @@
 #define FRAME_H
 
 #include <opencv2/opencv.hpp>
+#include "components/bayer.h"
 
 class Frame {
 public:
-    static cv::Mat centerObject(cv::Mat frame, int width, int height);
+    // Bright object on the dark background of a frame
+    struct ObjectLocation {
+        cv::Point2d center; // Intensity centroid, sub-pixel
+        cv::Rect bounds;
+        int threshold = 0;  // Background level, in the 8-bit range
+        bool found = false;
+    };
+
+    static ObjectLocation locateObject(const cv::Mat &frame);
+    static cv::Mat centerObject(cv::Mat frame, int width, int height, bool view = false);
     static cv::Mat expandBorders(cv::Mat frame, int width, int height);
-    static double estimateQuality(cv::Mat frame);
+    static double estimateQuality(cv::Mat frame, double scale = 0.5);
+    static cv::Point2f objectCentroid(const cv::Mat &gray, double threshold);
+    static double to8BitScale(int depth);
+    static cv::Mat luma(const cv::Mat &frame, Bayer::Pattern pattern, cv::Mat &buffer, int scale = 1);
 };
 
 #endif // FRAME_H
@@ -0,0 +1,207 @@
+#include "quality_metrics.h"
+#include "components/frame.h"
+#include <chrono>
+#include <cmath>
+
+static cv::Mat downscaled(const cv::Mat &gray, double scale) {
+    if (scale == 1.0) {
+        return gray;
+    }
+    cv::Mat result;
+    cv::resize(gray, result, cv::Size(), scale, scale, cv::INTER_AREA);
+    return result;
+}
+
+//
+// Mean of the capped gradient magnitude, see Frame::estimateQuality().
+//
+static double gradient(const cv::Mat &gray, double scale) {
+    return Frame::estimateQuality(gray, scale);
+}
+
+//
+// Variance of the Laplacian: second derivatives respond to fine detail
+// only, and their spread grows with the amount of it.
+//
+static double laplacianVariance(const cv::Mat &gray, double scale) {
+    cv::Mat laplacian;
+    cv::Laplacian(downscaled(gray, scale), laplacian, CV_32F, 3);
+
+    cv::Scalar mean, deviation;
+    cv::meanStdDev(laplacian, mean, deviation);
+    return deviation[0] * deviation[0];
+}
+
+//
+// Tenengrad: mean squared Sobel gradient magnitude, without capping,
+// so strong edges weigh more than with the gradient metric.
+//
+static double tenengrad(const cv::Mat &gray, double scale) {
+    cv::Mat reduced = downscaled(gray, scale);
+    cv::Mat gradX, gradY;
+    cv::Sobel(reduced, gradX, CV_32F, 1, 0, 3);
+    cv::Sobel(reduced, gradY, CV_32F, 0, 1, 3);
+
+    return cv::mean(gradX.mul(gradX) + gradY.mul(gradY))[0];
+}
+
+//
+// Energy of the second wavelet band (difference of Gaussians with
+// sigma 1 and 2). The finest band is mostly noise in planetary captures,
+// the second one holds the detail that seeing blurs out first.
+//
+static double waveletEnergy(const cv::Mat &gray, double scale) {
+    cv::Mat reduced;
+    downscaled(gray, scale).convertTo(reduced, CV_32F);
+
+    cv::Mat fine, coarse;
+    cv::GaussianBlur(reduced, fine, cv::Size(), 1.0);
+    cv::GaussianBlur(fine, coarse, cv::Size(), std::sqrt(3.0)); // 1 + 3 = 2^2
+
+    cv::Mat band = fine - coarse;
+    return cv::mean(band.mul(band))[0];
+}
+
+//
+// Mean local standard deviation over 9x9 windows, which measures contrast
+// independently of the overall brightness.
+//
+static double localContrast(const cv::Mat &gray, double scale) {
+    cv::Mat reduced;
+    downscaled(gray, scale).convertTo(reduced, CV_32F);
+
+    cv::Mat mean, meanOfSquares;
+    cv::blur(reduced, mean, cv::Size(9, 9));
+    cv::blur(reduced.mul(reduced), meanOfSquares, cv::Size(9, 9));
+
+    // Rounding can make flat areas slightly negative
+    cv::Mat variance = meanOfSquares - mean.mul(mean);
+    cv::max(variance, 0.0, variance);
+    cv::sqrt(variance, variance);
+    return cv::mean(variance)[0];
+}
+
+//
+// Returns all available metrics. The first one is the default.
+//
+const std::vector<QualityMetrics::Metric> &QualityMetrics::registry() {
+    static const std::vector<Metric> metrics{
+        {"Gradient", "Mean of the capped gradient magnitude, robust to a few strong edges", gradient},
+        {"Laplacian variance", "Variance of the Laplacian, sensitive to fine detail and noise", laplacianVariance},
+        {"Tenengrad", "Mean squared gradient magnitude, favours strong edges", tenengrad},
+        {"Wavelet energy", "Energy of the second wavelet band, where seeing blur shows first", waveletEnergy},
+        {"Local contrast", "Mean local standard deviation, independent of brightness", localContrast}
+    };
+    return metrics;
+}
+
+QualityMetrics::QualityMetrics(std::vector<int> selected) {
+    select(std::move(selected));
+}
+
+//
+// Selects the metrics (indices into 'registry()') to evaluate, and resets timings.
+//
+void QualityMetrics::select(std::vector<int> selected) {
+    _selected = std::move(selected);
+    _nanoseconds = std::vector<std::atomic<qint64>>(_selected.size() + 1);
+    _frames = 0;
+}
+
+//
+// Evaluates the selected metrics on 'luma' downscaled by 'scale', writing
+// one score per selected metric to 'scores'. Safe to call from several threads.
+//
+// With several metrics, the frame is downscaled once and shared.
+// A single metric gets the original frame, as it may fuse downscaling
+// into its own computation.
+//
+void QualityMetrics::evaluate(const cv::Mat &luma, double scale, std::vector<double> &scores) {
+    using Clock = std::chrono::steady_clock;
+    const auto &metrics = registry();
+
+    scores.resize(_selected.size());
+
+    cv::Mat prepared = luma;
+    if (_selected.size() > 1 && scale != 1.0) {
+        auto start = Clock::now();
+        prepared = downscaled(luma, scale);
+        scale = 1.0;
+        _nanoseconds.back() += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    for (int i = 0; i < _selected.size(); ++i) {
+        auto start = Clock::now();
+        scores[i] = metrics[_selected[i]].evaluate(prepared, scale);
+        _nanoseconds[i] += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    ++_frames;
+}
+
+//
+// Returns the average time per frame spent in selected metric 'slot' so far,
+// or in the shared downscale if 'slot' equals the number of selected metrics.
+//
+double QualityMetrics::milliseconds(int slot) const {
+    if (_frames == 0 || slot < 0 || slot >= _nanoseconds.size()) {
+        return 0.0;
+    }
+    return _nanoseconds[slot] / 1e6 / _frames;
+}
+
+//
+// Returns (frame, score) pairs sorted from the best frame to the worst,
+// with 'scores' (indexed by frame) normalized to [0, 1].
+//
+std::vector<std::pair<int, double>> QualityMetrics::rank(const std::vector<double> &scores) {
+    std::vector<std::pair<int, double>> ranked(scores.size());
+    if (scores.empty()) {
+        return ranked;
+    }
+
+    auto [minIt, maxIt] = std::minmax_element(scores.begin(), scores.end());
+    double minVal = *minIt;
+    double range = *maxIt - minVal;
+
+    for (int i = 0; i < scores.size(); ++i) {
+        ranked[i] = {i, range > 0.0 ? (scores[i] - minVal) / range : 1.0};
+    }
+
+    // Sort frames by quality (pair.second)
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.second > b.second;
+    });
+
+    return ranked;
+}
+
+//
+// Returns 'scores' with frames that weren't scored (NaN) filled by linear
+// interpolation between the nearest scored frames, or copying the nearest
+// one at both ends. All zero if no frame is scored.
+//
+std::vector<double> QualityMetrics::interpolate(std::vector<double> scores) {
+    int previous = -1;
+    for (int i = 0; i <= static_cast<int>(scores.size()); ++i) {
+        if (i < scores.size() && std::isnan(scores[i])) {
+            continue;
+        }
+
+        // Fill the gap between 'previous' and 'i'
+        for (int j = previous + 1; j < i; ++j) {
+            if (previous < 0) {
+                scores[j] = i < scores.size() ? scores[i] : 0.0;
+            }
+            else if (i == scores.size()) {
+                scores[j] = scores[previous];
+            }
+            else {
+                double t = static_cast<double>(j - previous) / (i - previous);
+                scores[j] = scores[previous] + t * (scores[i] - scores[previous]);
+            }
+        }
+        previous = i;
+    }
+    return scores;
+}
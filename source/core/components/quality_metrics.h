@@ -0,0 +1,49 @@
+#ifndef QUALITY_METRICS_H
+#define QUALITY_METRICS_H
+
+#include <opencv2/opencv.hpp>
+#include <QString>
+#include <atomic>
+
+// Registry of frame quality metrics, and evaluation of a selection of them.
+//
+// Every metric scores an 8-bit luminance frame, higher meaning sharper.
+// Selected metrics are evaluated together on the same prepared (downscaled)
+// frame, so comparing metrics needs a single decoding pass. The time spent
+// in each metric is measured, giving its per-frame cost on real captures.
+class QualityMetrics {
+public:
+    struct Metric {
+        QString name;
+        QString description;
+        // Scores 'gray' after downscaling it by 'scale'
+        double (*evaluate)(const cv::Mat &gray, double scale);
+    };
+
+    // Bump when a metric or the frame preparation changes, cached scores become stale
+    static constexpr quint32 version = 1;
+
+    static const std::vector<Metric> &registry();
+
+    explicit QualityMetrics(std::vector<int> selected = {0});
+
+    void select(std::vector<int> selected);
+    const std::vector<int> &selected() const { return _selected; }
+
+    void evaluate(const cv::Mat &luma, double scale, std::vector<double> &scores);
+    double milliseconds(int slot) const;
+    // Frames evaluated since the last selection
+    int evaluatedFrames() const { return _frames; }
+
+    static std::vector<std::pair<int, double>> rank(const std::vector<double> &scores);
+    static std::vector<double> interpolate(std::vector<double> scores);
+
+private:
+    std::vector<int> _selected;
+
+    // Time spent per selected metric, and in the shared downscale
+    std::vector<std::atomic<qint64>> _nanoseconds;
+    std::atomic<int> _frames = 0;
+};
+
+#endif // QUALITY_METRICS_H
@@ -0,0 +1,141 @@
+#include "analysis_cache.h"
+#include "components/quality_metrics.h"
+#include "data/image_sequence.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+//
+// Returns the cached analysis of the capture at 'path', which has 'frames'
+// frames, scored within an object window of size 'window', or whole if it
+// is empty. Nothing is cached if the sidecar is missing or stale.
+//
+AnalysisCache AnalysisCache::open(const QString &path, int frames, QSize window) {
+    AnalysisCache cache;
+    cache._path = path;
+    cache._fingerprint = _computeFingerprint(path);
+    cache._frames = frames;
+    cache._window = window;
+
+    if (!cache._load()) {
+        cache._scores.clear();
+    }
+
+    return cache;
+}
+
+void AnalysisCache::setScores(int metric, std::vector<float> scores) {
+    _scores[metric] = std::move(scores);
+}
+
+QString AnalysisCache::_sidecarPath(const QString &path) {
+    return path + ".pxanalysis";
+}
+
+//
+// Hashes the size and modification time of the capture at 'path', its first
+// 64 KB (the header and usually the first frame) and 4 KB blocks at eight
+// evenly spaced positions, which land in frames spread over the capture.
+// Reads well under 100 KB whatever the size of the capture.
+//
+// Image sequences are keyed by the name, size and modification time of every
+// member, as overwriting a member in place changes neither the directory's
+// size nor its modification time.
+//
+QByteArray AnalysisCache::_computeFingerprint(const QString &path) {
+    constexpr qint64 headerSize = 64 * 1024;
+    constexpr qint64 blockSize = 4 * 1024;
+    constexpr int blocks = 8;
+
+    QFileInfo info(path);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+
+    if (ImageSequence::isSequencePath(path)) {
+        for (const QString &member : ImageSequence(path).paths()) {
+            QFileInfo memberInfo(member);
+            hash.addData(memberInfo.fileName().toUtf8());
+            hash.addData(QByteArray::number(memberInfo.size()));
+            hash.addData(QByteArray::number(memberInfo.lastModified().toMSecsSinceEpoch()));
+        }
+        return hash.result();
+    }
+
+    QFile file(path);
+    if (info.isFile() && file.open(QIODevice::ReadOnly)) {
+        const qint64 size = file.size();
+        hash.addData(file.read(headerSize));
+        if (size > headerSize) {
+            for (int i = 1; i <= blocks; ++i) {
+                qint64 offset = headerSize + (size - headerSize - blockSize) * i / blocks;
+                if (offset >= headerSize && file.seek(offset)) {
+                    hash.addData(file.read(blockSize));
+                }
+            }
+        }
+    }
+
+    return hash.result();
+}
+
+bool AnalysisCache::_load() {
+    QFile file(_sidecarPath(_path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 fileMagic, fileVersion, metricsVersion;
+    QByteArray fingerprint;
+    qint32 frames;
+    QSize window;
+    in >> fileMagic >> fileVersion >> metricsVersion >> fingerprint >> frames >> window;
+
+    // Stale or foreign sidecar
+    if (in.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version
+        || metricsVersion != QualityMetrics::version || fingerprint != _fingerprint
+        || frames != _frames || window != _window) {
+        return false;
+    }
+
+    qint32 metrics;
+    in >> metrics;
+    for (int i = 0; i < metrics && in.status() == QDataStream::Ok; ++i) {
+        qint32 metric;
+        QList<float> scores;
+        in >> metric >> scores;
+        if (scores.size() != _frames) {
+            return false;
+        }
+        _scores[metric].assign(scores.begin(), scores.end());
+    }
+
+    return in.status() == QDataStream::Ok;
+}
+
+//
+// Writes the sidecar. Read-only locations simply get none.
+//
+bool AnalysisCache::save() const {
+    QFile file(_sidecarPath(_path));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    out << magic << version << QualityMetrics::version << _fingerprint << _frames << _window;
+
+    out << static_cast<qint32>(_scores.size());
+    for (const auto &[metric, scores] : _scores) {
+        out << static_cast<qint32>(metric) << QList<float>(scores.begin(), scores.end());
+    }
+
+    return out.status() == QDataStream::Ok;
+}
@@ -0,0 +1,46 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+#include <map>
+#include <vector>
+
+// Analysis results of a capture: quality scores per metric, per frame.
+//
+// Saved as a sidecar next to the capture, so reopening it loads the ranking
+// instead of analyzing every frame again. The sidecar is keyed by a
+// fingerprint of the capture (size, modification time, and a hash of its
+// header and of data sampled through it, or of every member of an image
+// sequence), the version of the metrics and the size of the window the
+// frames were scored in, and is ignored when any of them change.
+class AnalysisCache {
+public:
+    static AnalysisCache open(const QString &path, int frames, QSize window);
+
+    bool hasScores(int metric) const { return _scores.count(metric) > 0; }
+    const std::vector<float> &scores(int metric) const { return _scores.at(metric); }
+    void setScores(int metric, std::vector<float> scores);
+
+    bool save() const;
+
+private:
+    static constexpr quint32 magic = 0x50584143; // "PXAC"
+    static constexpr quint32 version = 3;
+
+    QString _path;
+    QByteArray _fingerprint;
+    qint32 _frames = 0;
+    // Empty for whole frames
+    QSize _window;
+
+    // Scores by metric (index in the registry)
+    std::map<int, std::vector<float>> _scores;
+
+    static QString _sidecarPath(const QString &path);
+    static QByteArray _computeFingerprint(const QString &path);
+    bool _load();
+};
+
+#endif // ANALYSIS_CACHE_H
@@ -0,0 +1,323 @@
+#include "avi_file.h"
+#include <QtEndian>
+#include <cstring>
+
+static bool isFourCC(const uchar *data, const char *id) {
+    return std::memcmp(data, id, 4) == 0;
+}
+
+//
+// Calls 'callback(chunk, size)' for every RIFF chunk between 'begin' and 'end',
+// 'chunk' being the offset of the chunk's header and 'size' the size of its data.
+//
+template <typename Callback>
+static void forEachChunk(const uchar *data, qint64 begin, qint64 end, Callback callback) {
+    qint64 chunk = begin;
+    while (chunk + 8 <= end) {
+        quint32 size = qFromLittleEndian<quint32>(data + chunk + 4);
+        callback(chunk, size);
+        // Chunks are padded to an even size
+        chunk += 8 + static_cast<qint64>(size) + (size & 1);
+    }
+}
+
+//
+// Opens and maps the AVI file at 'path' and builds its frame table.
+//
+// The file is a RIFF 'AVI ' chunk, followed by RIFF 'AVIX' chunks in
+// OpenDML files larger than 1 GB. Headers are in the 'hdrl' list of the
+// first one, frame chunks ('00db' / '00dc' for stream 0) in the 'movi'
+// lists of all of them.
+//
+// Captures that were cut off (e.g. a full disk) are accepted, frames
+// are read up to the last complete one.
+//
+AviFile::AviFile(const QString &path) : _file(path) {
+    if (!_file.open(QIODevice::ReadOnly) || _file.size() < 12) {
+        return;
+    }
+
+    _size = _file.size();
+
+    // Private mapping: accidental writes to a frame never reach the disk
+    _data = _file.map(0, _size, QFileDevice::MapPrivateOption);
+    if (!_data) {
+        return;
+    }
+
+    if (!isFourCC(_data, "RIFF") || !isFourCC(_data + 8, "AVI ")) {
+        _file.unmap(_data);
+        _data = nullptr;
+        return;
+    }
+
+    bool hasFormat = false;
+    qint64 superIndex = -1, legacyIndex = -1, firstMovie = -1;
+    quint32 superIndexSize = 0, legacyIndexSize = 0;
+    std::vector<std::pair<qint64, qint64>> movies;
+
+    // Stream headers: the first video stream is the one being read
+    auto parseHeaders = [&](qint64 begin, qint64 end) {
+        int stream = 0;
+        forEachChunk(_data, begin, end, [&](qint64 list, quint32 listSize) {
+            if (list + 12 > _size || !isFourCC(_data + list, "LIST") || listSize < 4 || !isFourCC(_data + list + 8, "strl")) {
+                return;
+            }
+
+            bool video = false;
+            qint64 format = -1, index = -1;
+            quint32 formatSize = 0, indexSize = 0;
+            qint64 listEnd = std::min(_size, list + 8 + listSize);
+
+            forEachChunk(_data, list + 12, listEnd, [&](qint64 chunk, quint32 size) {
+                if (chunk + 8 + size > _size) {
+                    return;
+                }
+                if (isFourCC(_data + chunk, "strh") && size >= 4) {
+                    video = isFourCC(_data + chunk + 8, "vids");
+                }
+                else if (isFourCC(_data + chunk, "strf")) {
+                    format = chunk + 8;
+                    formatSize = size;
+                }
+                else if (isFourCC(_data + chunk, "indx")) {
+                    index = chunk + 8;
+                    indexSize = size;
+                }
+            });
+
+            if (video && !hasFormat && format >= 0) {
+                hasFormat = _parseStreamFormat(_data + format, formatSize);
+                _streamId = QByteArray::number(stream).rightJustified(2, '0');
+                superIndex = index;
+                superIndexSize = indexSize;
+            }
+            ++stream;
+        });
+    };
+
+    // The AVI RIFF, then OpenDML extensions
+    qint64 riff = 0;
+    while (riff + 12 <= _size && isFourCC(_data + riff, "RIFF")) {
+        quint32 riffSize = qFromLittleEndian<quint32>(_data + riff + 4);
+        // Recording software that crashed may have left the size unset
+        qint64 riffEnd = riffSize == 0 ? _size : std::min(_size, riff + 8 + riffSize);
+
+        forEachChunk(_data, riff + 12, riffEnd, [&](qint64 chunk, quint32 size) {
+            qint64 chunkEnd = std::min(riffEnd, chunk + 8 + size);
+            if (isFourCC(_data + chunk, "LIST") && size >= 4 && chunk + 12 <= _size) {
+                if (isFourCC(_data + chunk + 8, "hdrl")) {
+                    parseHeaders(chunk + 12, chunkEnd);
+                }
+                else if (isFourCC(_data + chunk + 8, "movi")) {
+                    if (firstMovie < 0) {
+                        firstMovie = chunk + 8;
+                    }
+                    movies.emplace_back(chunk + 12, chunkEnd);
+                }
+            }
+            else if (isFourCC(_data + chunk, "idx1") && chunk + 8 + size <= _size) {
+                legacyIndex = chunk + 8;
+                legacyIndexSize = size;
+            }
+        });
+
+        riff = riffEnd + (riffEnd & 1);
+    }
+
+    if (hasFormat) {
+        // The OpenDML index covers all RIFFs, idx1 only the first one
+        if (superIndex >= 0) {
+            _readSuperIndex(superIndex, superIndexSize);
+        }
+        if (_offsets.empty() && legacyIndex >= 0 && firstMovie >= 0) {
+            _readLegacyIndex(legacyIndex, legacyIndexSize, firstMovie);
+        }
+        if (_offsets.empty()) {
+            for (const auto &[begin, end] : movies) {
+                _scanMovie(begin, end);
+            }
+        }
+    }
+
+    // Frames past the end of a truncated file
+    const qint64 frameBytes = static_cast<qint64>(_stride) * _dimensions.height;
+    auto truncated = std::find_if(_offsets.begin(), _offsets.end(), [this, frameBytes](qint64 offset) {
+        return offset < 0 || offset + frameBytes > _size;
+    });
+    _offsets.erase(truncated, _offsets.end());
+
+    if (_offsets.empty()) {
+        _file.unmap(_data);
+        _data = nullptr;
+    }
+}
+
+AviFile::~AviFile() {
+    if (_data) {
+        _file.unmap(_data);
+    }
+}
+
+//
+// Returns frame 'index' as a view into the mapping.
+//
+// Bottom-up (BI_RGB) frames are the only case that needs a copy.
+//
+cv::Mat AviFile::frame(int index) const {
+    if (!_data || index < 0 || index >= frames()) {
+        return {};
+    }
+
+    cv::Mat mat(_dimensions, _type, _data + _offsets[index], _stride);
+
+    if (_bottomUp) {
+        cv::Mat flipped;
+        cv::flip(mat, flipped, 0);
+        return flipped;
+    }
+
+    return mat;
+}
+
+quint32 AviFile::_u32(qint64 offset) const {
+    return qFromLittleEndian<quint32>(_data + offset);
+}
+
+//
+// Reads the stream's BITMAPINFOHEADER, returns false for formats
+// that need decoding.
+//
+// 8-bit BI_RGB data is paletted, capture software writes it
+// with a gray palette, which is assumed here.
+//
+bool AviFile::_parseStreamFormat(const uchar *strf, quint32 size) {
+    if (size < 40) {
+        return false;
+    }
+
+    int width = qFromLittleEndian<qint32>(strf + 4);
+    int height = qFromLittleEndian<qint32>(strf + 8);
+    int bitCount = qFromLittleEndian<quint16>(strf + 14);
+    const uchar *compression = strf + 16;
+    bool rgb = qFromLittleEndian<quint32>(compression) == 0;
+
+    if (width <= 0 || height == 0) {
+        return false;
+    }
+
+    if (rgb && (bitCount == 8 || bitCount == 24)) {
+        // BI_RGB rows are padded to 4 bytes, bottom-up unless the height is negative
+        _type = bitCount == 8 ? CV_8UC1 : CV_8UC3;
+        _stride = (static_cast<size_t>(width) * bitCount + 31) / 32 * 4;
+        _bottomUp = height > 0;
+    }
+    else if ((isFourCC(compression, "Y800") || isFourCC(compression, "Y8  ") || isFourCC(compression, "GREY")) && bitCount == 8) {
+        _type = CV_8UC1;
+        _stride = width;
+    }
+    else if (isFourCC(compression, "Y16 ") && bitCount == 16) {
+        // Little-endian 16-bit samples
+        _type = CV_16UC1;
+        _stride = static_cast<size_t>(width) * 2;
+    }
+    else {
+        return false;
+    }
+
+    _dimensions = {width, std::abs(height)};
+    return true;
+}
+
+//
+// Reads the frame table from an OpenDML super index ('indx'),
+// which points to one standard index ('ix00') per RIFF.
+//
+void AviFile::_readSuperIndex(qint64 offset, quint32 size) {
+    constexpr int headerSize = 24;
+    constexpr quint8 indexOfIndexes = 0x00;
+    constexpr quint8 indexOfChunks = 0x01;
+
+    if (size < headerSize || _data[offset + 3] != indexOfIndexes) {
+        return;
+    }
+
+    quint32 entries = std::min<quint32>(_u32(offset + 4), (size - headerSize) / 16);
+    for (quint32 i = 0; i < entries; ++i) {
+        qint64 entry = offset + headerSize + static_cast<qint64>(i) * 16;
+        qint64 chunk = qFromLittleEndian<qint64>(_data + entry);
+        if (chunk < 0 || chunk + 8 + headerSize > _size) {
+            break;
+        }
+
+        qint64 standard = chunk + 8;
+        quint32 standardSize = std::min<qint64>(_u32(chunk + 4), _size - standard);
+        if (standardSize < headerSize || _data[standard + 3] != indexOfChunks) {
+            continue;
+        }
+
+        quint32 count = std::min<quint32>(_u32(standard + 4), (standardSize - headerSize) / 8);
+        qint64 base = qFromLittleEndian<qint64>(_data + standard + 12);
+        for (quint32 j = 0; j < count; ++j) {
+            qint64 item = standard + headerSize + static_cast<qint64>(j) * 8;
+            // The top bit marks delta frames, meaningless for uncompressed data
+            quint32 frameSize = _u32(item + 4) & 0x7FFFFFFF;
+            // Empty entries are dropped frames
+            if (frameSize > 0) {
+                _offsets.push_back(base + _u32(item));
+            }
+        }
+    }
+}
+
+//
+// Reads the frame table from an AVI 1.0 index ('idx1').
+//
+// Offsets are relative to the 'movi' list, except in some writers'
+// files where they are absolute, which is detected on the first frame.
+//
+void AviFile::_readLegacyIndex(qint64 offset, quint32 size, qint64 movi) {
+    const quint32 entries = size / 16;
+
+    qint64 base = -1;
+    for (quint32 i = 0; i < entries; ++i) {
+        qint64 entry = offset + static_cast<qint64>(i) * 16;
+        if (std::memcmp(_data + entry, _streamId.constData(), 2) != 0 || _u32(entry + 12) == 0) {
+            continue;
+        }
+
+        qint64 chunk = _u32(entry + 8);
+        if (base < 0) {
+            base = _isFrameChunk(movi + chunk) ? movi : 0;
+        }
+        if (_isFrameChunk(base + chunk)) {
+            _offsets.push_back(base + chunk + 8);
+        }
+    }
+}
+
+//
+// Builds the frame table by walking the chunks of a 'movi' list.
+//
+void AviFile::_scanMovie(qint64 begin, qint64 end) {
+    forEachChunk(_data, begin, end, [this](qint64 chunk, quint32 size) {
+        if (isFourCC(_data + chunk, "LIST") && size >= 4 && chunk + 12 <= _size && isFourCC(_data + chunk + 8, "rec ")) {
+            _scanMovie(chunk + 12, std::min(_size, chunk + 8 + size));
+        }
+        else if (size > 0 && _isFrameChunk(chunk)) {
+            _offsets.push_back(chunk + 8);
+        }
+    });
+}
+
+//
+// Returns true if a video frame chunk of the read stream starts at 'offset'.
+//
+bool AviFile::_isFrameChunk(qint64 offset) const {
+    if (offset < 0 || offset + 8 > _size) {
+        return false;
+    }
+    const uchar *id = _data + offset;
+    return std::memcmp(id, _streamId.constData(), 2) == 0
+        && (std::memcmp(id + 2, "db", 2) == 0 || std::memcmp(id + 2, "dc", 2) == 0);
+}
@@ -0,0 +1,53 @@
+#ifndef AVI_FILE_H
+#define AVI_FILE_H
+
+#include <opencv2/opencv.hpp>
+#include <QFile>
+
+// Memory-mapped reader for uncompressed AVI captures (AVI 1.0 and OpenDML).
+//
+// Supported video formats are 8-bit mono (Y800 / GREY, or 8-bit BI_RGB),
+// 16-bit mono (Y16) and 24-bit BGR (BI_RGB). Frame positions come from
+// the OpenDML index, the legacy idx1 index, or a scan of the movie data.
+// Files using any other format are reported invalid, so callers can fall
+// back to a decoder.
+class AviFile {
+public:
+    explicit AviFile(const QString &path);
+    ~AviFile();
+
+    bool isValid() const { return _data != nullptr; }
+    int frames() const { return static_cast<int>(_offsets.size()); }
+    cv::Size dimensions() const { return _dimensions; }
+    int type() const { return _type; }
+
+    cv::Mat frame(int index) const;
+
+    AviFile(const AviFile &) = delete;
+    AviFile& operator=(const AviFile &) = delete;
+
+private:
+    QFile _file;
+    uchar *_data = nullptr;
+    qint64 _size = 0;
+
+    // Data offset of every frame
+    std::vector<qint64> _offsets;
+
+    cv::Size _dimensions = {0, 0};
+    int _type = CV_8UC1;
+    size_t _stride = 0;
+    bool _bottomUp = false;
+
+    // First two characters of the video stream's chunk IDs (e.g. "00" in "00db")
+    QByteArray _streamId;
+
+    quint32 _u32(qint64 offset) const;
+    bool _parseStreamFormat(const uchar *strf, quint32 size);
+    void _readSuperIndex(qint64 offset, quint32 size);
+    void _readLegacyIndex(qint64 offset, quint32 size, qint64 movi);
+    void _scanMovie(qint64 begin, qint64 end);
+    bool _isFrameChunk(qint64 offset) const;
+};
+
+#endif // AVI_FILE_H
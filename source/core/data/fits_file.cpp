@@ -0,0 +1,255 @@
+#include "fits_file.h"
+#include <QtEndian>
+#include <QMap>
+
+//
+// Opens and maps the FITS file at 'path' and parses its primary header.
+//
+// Supported data: BITPIX 8, 16 (signed, or unsigned through BZERO = 32768) and -32.
+// Rows are read top-down unless ROWORDER says otherwise: capture software
+// writes them in sensor order, and flipping would rule out zero-copy access.
+//
+// Float data is mapped to [0, 1] from DATAMIN / DATAMAX if the header has
+// them, else from the range of the first frame if it isn't [0, 1] already.
+//
+FitsFile::FitsFile(const QString &path) : _file(path) {
+    if (!_file.open(QIODevice::ReadOnly) || _file.size() < blockSize) {
+        return;
+    }
+
+    uchar *data = _file.map(0, _file.size(), QFileDevice::MapPrivateOption);
+    if (!data) {
+        return;
+    }
+
+    // Header cards up to END
+    QMap<QString, QString> cards;
+    qint64 offset = 0;
+    bool ended = false;
+    for (; offset + cardSize <= _file.size(); offset += cardSize) {
+        QString card = QString::fromLatin1(reinterpret_cast<const char *>(data + offset), cardSize);
+        QString keyword = card.left(8).trimmed();
+        if (keyword == "END") {
+            ended = true;
+            offset += cardSize;
+            break;
+        }
+        if (card.mid(8, 2) == "= ") {
+            // Value up to the comment, quotes removed from strings
+            QString value = card.mid(10);
+            if (value.trimmed().startsWith('\'')) {
+                value = value.section('\'', 1, 1);
+            }
+            else {
+                value = value.section('/', 0, 0);
+            }
+            cards.insert(keyword, value.trimmed());
+        }
+    }
+
+    if (!ended || cards.value("SIMPLE") != "T") {
+        _file.unmap(data);
+        return;
+    }
+
+    _bitpix = cards.value("BITPIX").toInt();
+    _bzero = cards.value("BZERO", "0").toDouble();
+    _bscale = cards.value("BSCALE", "1").toDouble();
+    int naxis = cards.value("NAXIS").toInt();
+    int width = cards.value("NAXIS1").toInt();
+    int height = cards.value("NAXIS2").toInt();
+    int depth = naxis >= 3 ? cards.value("NAXIS3").toInt() : 1;
+    bool hasRange = cards.contains("DATAMIN") && cards.contains("DATAMAX");
+    double dataMin = cards.value("DATAMIN").toDouble();
+    double dataMax = cards.value("DATAMAX").toDouble();
+    _bottomUp = cards.value("ROWORDER").compare("BOTTOM-UP", Qt::CaseInsensitive) == 0;
+    _bayerPattern = cards.value("BAYERPAT");
+
+    int cvDepth;
+    switch (_bitpix) {
+    case 8:
+        cvDepth = CV_8U;
+        break;
+    case 16:
+        cvDepth = CV_16U;
+        break;
+    case -32:
+        cvDepth = CV_32F;
+        break;
+    default:
+        cvDepth = -1;
+        break;
+    }
+
+    if (cvDepth < 0 || naxis < 2 || naxis > 3 || width <= 0 || height <= 0 || depth <= 0) {
+        _file.unmap(data);
+        return;
+    }
+
+    // Three planes make a color image, anything else is a cube of mono frames
+    _planes = depth == 3 ? 3 : 1;
+    if (_planes == 3) {
+        _bayerPattern.clear();
+    }
+    _frames = depth == 3 ? 1 : depth;
+    _dimensions = {width, height};
+    _type = CV_MAKETYPE(cvDepth, _planes);
+    _planeBytes = static_cast<qint64>(width) * height * (std::abs(_bitpix) / 8);
+    _dataOffset = (offset + blockSize - 1) / blockSize * blockSize;
+
+    if (_dataOffset + _planeBytes * _planes * _frames > _file.size()) {
+        _file.unmap(data);
+        return;
+    }
+
+    _data = data;
+
+    if (_bitpix == -32) {
+        if (!hasRange) {
+            cv::minMaxLoc(frame(0).reshape(1), &dataMin, &dataMax);
+            hasRange = dataMin < 0.0 || dataMax > 1.0;
+        }
+        if (hasRange && dataMax > dataMin) {
+            // Folded into BSCALE / BZERO, applied while converting planes
+            const double range = dataMax - dataMin;
+            _bzero = (_bzero - dataMin) / range;
+            _bscale /= range;
+        }
+    }
+}
+
+FitsFile::~FitsFile() {
+    if (_data) {
+        _file.unmap(_data);
+    }
+}
+
+cv::Mat FitsFile::frame(int index) const {
+    if (!_data || index < 0 || index >= _frames) {
+        return {};
+    }
+
+    const uchar *data = _data + _dataOffset + _planeBytes * _planes * index;
+
+    cv::Mat mat;
+    if (_planes == 1) {
+        mat = _plane(data);
+    }
+    else {
+        // R, G, B planes to interleaved BGR
+        std::vector<cv::Mat> bgr{_plane(data + 2 * _planeBytes), _plane(data + _planeBytes), _plane(data)};
+        cv::merge(bgr, mat);
+    }
+
+    if (_bottomUp) {
+        cv::flip(mat, mat, 0);
+    }
+
+    return mat;
+}
+
+//
+// Converts a single big-endian plane to host order.
+//
+// 8-bit planes are returned as views into the mapping.
+//
+cv::Mat FitsFile::_plane(const uchar *data) const {
+    const int count = _dimensions.area();
+
+    switch (_bitpix) {
+    case 8:
+        return cv::Mat(_dimensions, CV_8UC1, const_cast<uchar *>(data));
+
+    case 16: {
+        cv::Mat plane(_dimensions, CV_16UC1);
+        qFromBigEndian<quint16>(data, count, plane.data);
+
+        if (_bzero == 32768.0 && _bscale == 1.0) {
+            // Unsigned data stored as signed, flipping the sign bit adds 32768
+            cv::bitwise_xor(plane, cv::Scalar(0x8000), plane);
+        }
+        else {
+            // Signed data, negative values are clipped
+            cv::Mat result;
+            cv::Mat(_dimensions, CV_16SC1, plane.data).convertTo(result, CV_16U, _bscale, _bzero);
+            plane = result;
+        }
+        return plane;
+    }
+
+    case -32: {
+        cv::Mat plane(_dimensions, CV_32FC1);
+        qFromBigEndian<quint32>(data, count, plane.data);
+        // Undefined (blank) pixels
+        cv::patchNaNs(plane, 0.0);
+
+        if (_bzero != 0.0 || _bscale != 1.0) {
+            plane.convertTo(plane, CV_32F, _bscale, _bzero);
+        }
+        return plane;
+    }
+    }
+
+    return {};
+}
+
+//
+// Writes 'mat' multiplied by 'scale' as a 32-bit float FITS image.
+//
+// Color images are written as three planes in R, G, B order.
+//
+bool FitsFile::write(const QString &path, const cv::Mat &mat, double scale) {
+    if (mat.empty() || (mat.channels() != 1 && mat.channels() != 3)) {
+        return false;
+    }
+
+    cv::Mat data;
+    mat.convertTo(data, CV_32F, scale);
+
+    std::vector<cv::Mat> planes;
+    cv::split(data, planes);
+    if (planes.size() == 3) {
+        std::swap(planes[0], planes[2]);
+    }
+
+    QByteArray header;
+    auto card = [&header](const QString &keyword, const QString &value) {
+        // Fixed format: strings start at column 11, other values end at column 30
+        int width = value.startsWith('\'') ? -20 : 20;
+        header += QString("%1= %2").arg(keyword, -8).arg(value, width).toLatin1().leftJustified(cardSize, ' ', true);
+    };
+
+    card("SIMPLE", "T");
+    card("BITPIX", "-32");
+    card("NAXIS", planes.size() == 3 ? "3" : "2");
+    card("NAXIS1", QString::number(mat.cols));
+    card("NAXIS2", QString::number(mat.rows));
+    if (planes.size() == 3) {
+        card("NAXIS3", "3");
+    }
+    card("ROWORDER", "'TOP-DOWN'");
+    card("CREATOR", "'Proxima'");
+    header += QByteArray("END").leftJustified(cardSize, ' ');
+    header = header.leftJustified((header.size() + blockSize - 1) / blockSize * blockSize, ' ');
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    file.write(header);
+
+    qint64 written = 0;
+    QByteArray bytes;
+    for (const auto &plane : planes) {
+        bytes.resize(plane.total() * sizeof(float));
+        qToBigEndian<quint32>(plane.data, plane.total(), bytes.data());
+        written += file.write(bytes);
+    }
+
+    // Data is padded to a whole number of blocks as well
+    qint64 padding = (blockSize - written % blockSize) % blockSize;
+    file.write(QByteArray(padding, '\0'));
+
+    return file.error() == QFileDevice::NoError;
+}
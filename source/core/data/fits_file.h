@@ -0,0 +1,57 @@
+#ifndef FITS_FILE_H
+#define FITS_FILE_H
+
+#include <opencv2/opencv.hpp>
+#include <QFile>
+
+// Memory-mapped reader and 32-bit float writer for FITS images and cubes.
+//
+// 2D images are single frames. 3D data with NAXIS3 = 3 is read as one color
+// image (planes in R, G, B order), any other NAXIS3 is a cube of mono frames.
+//
+// 8-bit frames are views into the mapping, 16-bit and float data is big-endian
+// on disk and gets byte-swapped straight from the mapping into the result.
+// Float data is mapped to the [0, 1] range, which is also what the writer produces.
+class FitsFile {
+public:
+    explicit FitsFile(const QString &path);
+    ~FitsFile();
+
+    bool isValid() const { return _data != nullptr; }
+    int frames() const { return _frames; }
+    cv::Size dimensions() const { return _dimensions; }
+    int type() const { return _type; }
+    // BAYERPAT card of raw color captures, empty otherwise
+    QString bayerPattern() const { return _bayerPattern; }
+
+    cv::Mat frame(int index) const;
+
+    static bool write(const QString &path, const cv::Mat &mat, double scale = 1.0);
+
+    FitsFile(const FitsFile &) = delete;
+    FitsFile& operator=(const FitsFile &) = delete;
+
+private:
+    static constexpr qint64 blockSize = 2880;
+    static constexpr int cardSize = 80;
+
+    QFile _file;
+    uchar *_data = nullptr;
+    qint64 _dataOffset = 0;
+
+    int _bitpix = 0;
+    double _bzero = 0.0;
+    double _bscale = 1.0;
+    int _planes = 1;
+    bool _bottomUp = false;
+    QString _bayerPattern;
+
+    int _frames = 0;
+    cv::Size _dimensions = {0, 0};
+    int _type = CV_8UC1;
+    qint64 _planeBytes = 0;
+
+    cv::Mat _plane(const uchar *data) const;
+};
+
+#endif // FITS_FILE_H
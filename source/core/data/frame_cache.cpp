@@ -0,0 +1,115 @@
+#include "frame_cache.h"
+
+FrameCache &FrameCache::shared() {
+    static FrameCache cache;
+    return cache;
+}
+
+//
+// Looks up 'frame' of 'file' and marks it as recently used.
+//
+// The returned mat is shared with the cache and must not be modified.
+//
+bool FrameCache::find(const MediaFile *file, int frame, cv::Mat &mat) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto it = _entries.find({file, frame});
+    if (it == _entries.end()) {
+        return false;
+    }
+
+    Entry &entry = it->second;
+    _ranks.erase({entry.priority, entry.tick, it->first});
+    entry.tick = ++_tick;
+    _ranks.insert({entry.priority, entry.tick, it->first});
+
+    mat = entry.mat;
+    return true;
+}
+
+//
+// Stores a copy of 'mat' as 'frame' of 'file'.
+//
+// The frame is not admitted if making room for it would evict an entry
+// with a higher priority.
+//
+void FrameCache::insert(const MediaFile *file, int frame, const cv::Mat &mat, double priority) {
+    if (mat.empty()) {
+        return;
+    }
+
+    size_t bytes = mat.total() * mat.elemSize();
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    if (bytes > _budget) {
+        return;
+    }
+
+    Key key{file, frame};
+    auto it = _entries.find(key);
+    if (it != _entries.end()) {
+        // Already cached, only refresh its rank
+        Entry &entry = it->second;
+        _ranks.erase({entry.priority, entry.tick, key});
+        entry.priority = std::max(entry.priority, priority);
+        entry.tick = ++_tick;
+        _ranks.insert({entry.priority, entry.tick, key});
+        return;
+    }
+
+    // Admission check
+    size_t freed = 0;
+    for (auto rank = _ranks.begin(); rank != _ranks.end() && _size - freed + bytes > _budget; ++rank) {
+        if (std::get<0>(*rank) > priority) {
+            return;
+        }
+        freed += _entries.at(std::get<2>(*rank)).bytes;
+    }
+
+    _evict(bytes);
+
+    _entries.emplace(key, Entry{mat.clone(), bytes, priority, ++_tick});
+    _ranks.insert({priority, _tick, key});
+    _size += bytes;
+}
+
+//
+// Drops every cached frame of 'file'.
+//
+void FrameCache::erase(const MediaFile *file) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto it = _entries.lower_bound({file, std::numeric_limits<int>::min()});
+    while (it != _entries.end() && it->first.first == file) {
+        auto next = std::next(it);
+        _remove(it);
+        it = next;
+    }
+}
+
+void FrameCache::clear() {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _entries.clear();
+    _ranks.clear();
+    _size = 0;
+}
+
+void FrameCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _budget = bytes;
+    _evict(0);
+}
+
+// Evicts entries until 'bytes' more fit into the budget
+void FrameCache::_evict(size_t bytes) {
+    while (!_ranks.empty() && _size + bytes > _budget) {
+        _remove(_entries.find(std::get<2>(*_ranks.begin())));
+    }
+}
+
+void FrameCache::_remove(std::map<Key, Entry>::iterator it) {
+    _ranks.erase({it->second.priority, it->second.tick, it->first});
+    _size -= it->second.bytes;
+    _entries.erase(it);
+}
@@ -0,0 +1,57 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <set>
+#include <mutex>
+
+class MediaFile;
+
+// Memory-budgeted cache of decoded frames keyed by (file, frame index).
+//
+// A single instance is shared by the viewer, analysis and stacking.
+// Every entry has a priority: when the budget is exceeded, entries with the
+// lowest priority are evicted first, least recently used among equals.
+// Plain reads are cached with priority 0, analysis inserts frames with their
+// quality, so the best frames of a capture survive a full analysis pass.
+class FrameCache {
+public:
+    static FrameCache &shared();
+
+    bool find(const MediaFile *file, int frame, cv::Mat &mat);
+    void insert(const MediaFile *file, int frame, const cv::Mat &mat, double priority = 0.0);
+    void erase(const MediaFile *file);
+    void clear();
+
+    void setBudget(size_t bytes);
+    size_t budget() const { return _budget; }
+
+private:
+    FrameCache() = default;
+
+    using Key = std::pair<const MediaFile *, int>;
+    // Eviction order: (priority, last use tick, key)
+    using Rank = std::tuple<double, uint64_t, Key>;
+
+    struct Entry {
+        cv::Mat mat;
+        size_t bytes;
+        double priority;
+        uint64_t tick;
+    };
+
+    std::map<Key, Entry> _entries;
+    std::set<Rank> _ranks;
+
+    size_t _budget = size_t(1) << 30;
+    size_t _size = 0;
+    uint64_t _tick = 0;
+
+    std::mutex _mtx;
+
+    void _evict(size_t bytes);
+    void _remove(std::map<Key, Entry>::iterator it);
+};
+
+#endif // FRAME_CACHE_H
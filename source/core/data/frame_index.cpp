@@ -0,0 +1,111 @@
+#include "frame_index.h"
+#include <opencv2/opencv.hpp>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+//
+// Returns the index of the video at 'path', loading its sidecar if it is
+// up to date and building (and saving) it otherwise.
+//
+FrameIndex FrameIndex::open(const QString &path) {
+    FrameIndex index;
+
+    QFileInfo info(path);
+    index._fileSize = info.size();
+    index._modified = info.lastModified().toMSecsSinceEpoch();
+
+    if (index._load(path)) {
+        return index;
+    }
+
+    index._build(path);
+    if (index.isValid()) {
+        // Read-only locations simply get no sidecar
+        index._save(path);
+    }
+
+    return index;
+}
+
+//
+// Returns the last keyframe at or before 'frame', or -1 if unknown.
+//
+int FrameIndex::keyframeBefore(int frame) const {
+    auto it = std::upper_bound(_keyframes.begin(), _keyframes.end(), frame);
+    if (it == _keyframes.begin()) {
+        return -1;
+    }
+    return *std::prev(it);
+}
+
+QString FrameIndex::_sidecarPath(const QString &path) {
+    return path + ".pxindex";
+}
+
+bool FrameIndex::_load(const QString &path) {
+    QFile file(_sidecarPath(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 fileMagic, fileVersion;
+    qint64 fileSize, modified;
+    qint32 frames;
+    QList<qint32> keyframes;
+    in >> fileMagic >> fileVersion >> fileSize >> modified >> frames >> keyframes;
+
+    // Stale or foreign sidecar
+    if (in.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version
+        || fileSize != _fileSize || modified != _modified || frames <= 0) {
+        return false;
+    }
+
+    _frames = frames;
+    _keyframes.assign(keyframes.begin(), keyframes.end());
+    return true;
+}
+
+bool FrameIndex::_save(const QString &path) const {
+    QFile file(_sidecarPath(path));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << magic << version << _fileSize << _modified << static_cast<qint32>(_frames)
+        << QList<qint32>(_keyframes.begin(), _keyframes.end());
+
+    return out.status() == QDataStream::Ok;
+}
+
+//
+// Walks every packet of the video at 'path' to count frames and find keyframes.
+//
+// The FFmpeg backend is asked for raw packets, so nothing is decoded.
+// Other backends can only count frames by grabbing (decoding) them,
+// and provide no keyframe positions.
+//
+void FrameIndex::_build(const QString &path) {
+    _frames = 0;
+    _keyframes.clear();
+
+    cv::VideoCapture raw;
+    raw.open(path.toStdString(), cv::CAP_FFMPEG, {cv::CAP_PROP_FORMAT, -1});
+    if (raw.isOpened()) {
+        while (raw.grab()) {
+            if (raw.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0.0) {
+                _keyframes.push_back(_frames);
+            }
+            ++_frames;
+        }
+        return;
+    }
+
+    cv::VideoCapture capture(path.toStdString());
+    while (capture.grab()) {
+        ++_frames;
+    }
+}
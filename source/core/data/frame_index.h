@@ -0,0 +1,36 @@
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <QString>
+#include <vector>
+
+// Exact frame count and keyframe positions of a video file.
+//
+// Built once by walking the container's packets (no decoding) and saved
+// as a sidecar next to the capture, later opens only read the sidecar.
+// The sidecar is rebuilt when the capture's size or modification time change.
+class FrameIndex {
+public:
+    static FrameIndex open(const QString &path);
+
+    bool isValid() const { return _frames > 0; }
+    int frames() const { return _frames; }
+    bool hasKeyframes() const { return !_keyframes.empty(); }
+    int keyframeBefore(int frame) const;
+
+private:
+    static constexpr quint32 magic = 0x50584958; // "PXIX"
+    static constexpr quint32 version = 1;
+
+    int _frames = 0;
+    std::vector<int> _keyframes;
+    qint64 _fileSize = 0;
+    qint64 _modified = 0;
+
+    static QString _sidecarPath(const QString &path);
+    bool _load(const QString &path);
+    bool _save(const QString &path) const;
+    void _build(const QString &path);
+};
+
+#endif // FRAME_INDEX_H
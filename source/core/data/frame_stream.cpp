@@ -0,0 +1,165 @@
+#include "frame_stream.h"
+#include "components/frame.h"
+
+//
+// Starts decoding 'frames' (global frame numbers) from 'collection'.
+//
+// At most 'capacity' decoded frames are in flight at any time:
+// decoders block until workers recycle the buffers they hold.
+//
+FrameStream::FrameStream(MediaCollection &collection, const std::vector<int> &frames, int capacity, ReadMode mode)
+    : _collection(collection), _mode(mode)
+{
+    capacity = std::max(1, capacity);
+    _buffers.resize(capacity);
+    _lumaBuffers.resize(capacity);
+    for (int i = 0; i < capacity; ++i) {
+        _free.push(i);
+    }
+
+    // Group requested frames per file as (index, local frame) pairs
+    std::vector<std::vector<std::pair<int, int>>> perFile(_collection.fileCount());
+    for (int i = 0; i < frames.size(); ++i) {
+        auto [file, local] = _collection.locate(frames[i]);
+        if (file >= 0) {
+            perFile[file].emplace_back(i, local);
+        }
+    }
+
+    // Split every file into contiguous ranges, one per leased decoder
+    struct Range {
+        int file;
+        std::vector<std::pair<int, int>> frames;
+    };
+    std::vector<Range> ranges;
+
+    for (int i = 0; i < perFile.size(); ++i) {
+        auto &group = perFile[i];
+        if (group.empty()) {
+            continue;
+        }
+
+        // Walk each range forward, sequential access is much cheaper than seeking
+        std::sort(group.begin(), group.end(), [](const auto &a, const auto &b) {
+            return a.second < b.second;
+        });
+
+        // Short ranges aren't worth the seek and the decoder they need.
+        // One decoder is left for interactive reads (e.g. the viewer).
+        constexpr int minRangeFrames = 64;
+        int maxRanges = std::max(1, _collection[i].maxDecoders() - 1);
+        int count = std::clamp(static_cast<int>(group.size()) / minRangeFrames, 1, maxRanges);
+
+        for (int j = 0; j < count; ++j) {
+            auto begin = group.begin() + group.size() * j / count;
+            auto end = group.begin() + group.size() * (j + 1) / count;
+            ranges.push_back({i, {begin, end}});
+        }
+    }
+
+    _activeDecoders = static_cast<int>(ranges.size());
+
+    for (auto &range : ranges) {
+        _decoders.emplace_back(&FrameStream::_decode, this, std::ref(_collection[range.file]), std::move(range.frames), _collection.fileOffset(range.file));
+    }
+}
+
+FrameStream::~FrameStream() {
+    stop();
+}
+
+//
+// Blocks until a decoded frame is available and moves it into 'item'.
+//
+// Returns false once every requested frame has been delivered
+// or the stream was stopped.
+//
+bool FrameStream::next(Item &item) {
+    std::unique_lock<std::mutex> lock(_mtx);
+    _readyCondition.wait(lock, [this] {
+        return _stopped || !_ready.empty() || _activeDecoders == 0;
+    });
+
+    if (_ready.empty()) {
+        return false;
+    }
+
+    item = std::move(_ready.front());
+    _ready.pop();
+    return true;
+}
+
+//
+// Returns the buffer held by 'item' to the ring.
+//
+void FrameStream::recycle(Item &item) {
+    if (item.slot < 0) {
+        return;
+    }
+
+    item.mat.release();
+    item.source.release();
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _free.push(item.slot);
+    }
+    item.slot = -1;
+    _freeCondition.notify_one();
+}
+
+//
+// Stops decoding and waits for the decode threads to exit.
+//
+void FrameStream::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stopped = true;
+    }
+    _freeCondition.notify_all();
+    _readyCondition.notify_all();
+
+    for (auto &decoder : _decoders) {
+        if (decoder.joinable()) {
+            decoder.join();
+        }
+    }
+}
+
+void FrameStream::_decode(MediaFile &file, std::vector<std::pair<int, int>> frames, int offset) {
+    MediaFile::DecoderLease lease = file.leaseDecoder(frames.front().second);
+
+    for (const auto &[index, frame] : frames) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _freeCondition.wait(lock, [this] { return _stopped || !_free.empty(); });
+            if (_stopped) {
+                break;
+            }
+            slot = _free.front();
+            _free.pop();
+        }
+
+        // The slot is owned by this thread until it is queued
+        cv::Mat source = lease.read(frame, _buffers[slot]);
+        cv::Mat mat = source;
+        int scale = file.sampleScale();
+        if (_mode == ReadMode::Luma) {
+            // Scaling is folded into the conversion to 8 bits
+            mat = Frame::luma(source, file.bayerPattern(), _lumaBuffers[slot], scale);
+            scale = 1;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _ready.push({index, offset + frame, mat, source, file.bayerPattern(), scale, slot});
+        }
+        _readyCondition.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        --_activeDecoders;
+    }
+    _readyCondition.notify_all();
+}
@@ -0,0 +1,61 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <condition_variable>
+#include <queue>
+#include <thread>
+#include "data/media_collection.h"
+
+// Streams decoded frames of a MediaCollection to worker threads.
+//
+// Requested frames of every file are split into contiguous ranges, each walked
+// in order by its own decode thread with its own leased decoder, filling
+// a bounded ring of reusable buffers. Workers take frames with 'next()'
+// and hand the buffers back with 'recycle()', so decoding overlaps with
+// processing and no frame is allocated once the ring is warm.
+//
+// In luma mode, frames are reduced to 8-bit luminance by the decode threads,
+// mono captures pass through untouched and raw ones are never debayered.
+// Native frames keep the samples of the file, consumers apply 'Item::scale'.
+class FrameStream {
+public:
+    struct Item {
+        int index = -1; // Position in the requested frames
+        int frame = -1; // Global frame number in the collection
+        cv::Mat mat;    // Frame in the requested mode
+        cv::Mat source; // Frame as read from the file, 'mat' may be derived from it
+        Bayer::Pattern bayer = Bayer::Pattern::None; // Mosaic layout of 'mat', if raw
+        int scale = 1;  // Brings 'mat' to the full range of its type, see MediaFile::sampleScale()
+        int slot = -1;
+    };
+
+    FrameStream(MediaCollection &collection, const std::vector<int> &frames, int capacity, ReadMode mode = ReadMode::Native);
+    ~FrameStream();
+
+    bool next(Item &item);
+    void recycle(Item &item);
+    void stop();
+
+    FrameStream(const FrameStream &) = delete;
+    FrameStream& operator=(const FrameStream &) = delete;
+
+private:
+    MediaCollection &_collection;
+    ReadMode _mode;
+    std::vector<std::thread> _decoders;
+    std::vector<cv::Mat> _buffers;
+    std::vector<cv::Mat> _lumaBuffers;
+
+    std::queue<int> _free;
+    std::queue<Item> _ready;
+    int _activeDecoders = 0;
+    bool _stopped = false;
+
+    std::mutex _mtx;
+    std::condition_variable _freeCondition;
+    std::condition_variable _readyCondition;
+
+    void _decode(MediaFile &file, std::vector<std::pair<int, int>> frames, int offset);
+};
+
+#endif // FRAME_STREAM_H
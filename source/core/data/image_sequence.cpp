@@ -0,0 +1,86 @@
+#include "image_sequence.h"
+#include "data/media_file.h"
+#include <QCollator>
+#include <QDateTime>
+#include <QDir>
+#include <QImageReader>
+
+//
+// Lists the frames of the sequence at 'path', a directory or a wildcard
+// pattern in the file name part, and probes the first one for dimensions.
+//
+// Files that aren't supported images are ignored.
+//
+ImageSequence::ImageSequence(const QString &path) {
+    QFileInfo info(path);
+    QDir dir(info.isDir() ? path : info.path());
+    QStringList filters{info.isDir() ? "*" : info.fileName()};
+
+    QFileInfoList entries = dir.entryInfoList(filters, QDir::Files | QDir::Readable);
+    entries.removeIf([](const QFileInfo &entry) {
+        return !imageExtensions.contains("." + entry.suffix().toLower());
+    });
+
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    bool numbered = std::all_of(entries.begin(), entries.end(), [](const QFileInfo &entry) {
+        QString name = entry.completeBaseName();
+        return std::any_of(name.begin(), name.end(), [](QChar c) { return c.isDigit(); });
+    });
+
+    if (numbered) {
+        // Natural order, so that "frame_9" comes before "frame_10"
+        QCollator collator;
+        collator.setNumericMode(true);
+        std::sort(entries.begin(), entries.end(), [&collator](const QFileInfo &a, const QFileInfo &b) {
+            return collator.compare(a.fileName(), b.fileName()) < 0;
+        });
+    }
+    else {
+        std::sort(entries.begin(), entries.end(), [](const QFileInfo &a, const QFileInfo &b) {
+            return a.lastModified() < b.lastModified();
+        });
+    }
+
+    for (const auto &entry : entries) {
+        _paths.append(entry.absoluteFilePath());
+        _size += entry.size();
+    }
+
+    QSize size = QImageReader(_paths.front()).size();
+    if (size.isValid()) {
+        _dimensions = {size.width(), size.height()};
+    }
+    else {
+        // Format without a header-only reader
+        _dimensions = frame(0).size();
+    }
+}
+
+//
+// Returns true if 'path' names a sequence rather than a single file.
+//
+bool ImageSequence::isSequencePath(const QString &path) {
+    return path.contains('*') || path.contains('?') || QFileInfo(path).isDir();
+}
+
+//
+// Decodes frame 'index'. Safe to call from several threads at once.
+//
+cv::Mat ImageSequence::frame(int index) const {
+    if (index < 0 || index >= _paths.size()) {
+        return {};
+    }
+
+    const QString &path = _paths[index];
+    if (fitsExtensions.contains("." + QFileInfo(path).suffix().toLower())) {
+        FitsFile fits(path);
+        cv::Mat mat = fits.frame(0);
+        // 8-bit frames are views into the mapping, which goes away with 'fits'
+        return mat.depth() == CV_8U ? mat.clone() : mat;
+    }
+
+    return cv::imread(path.toStdString());
+}
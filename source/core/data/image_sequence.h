@@ -0,0 +1,34 @@
+#ifndef IMAGE_SEQUENCE_H
+#define IMAGE_SEQUENCE_H
+
+#include <opencv2/opencv.hpp>
+#include <QStringList>
+
+// Folder of still images read as the frames of a single capture.
+//
+// Created from a directory (every supported image in it) or a wildcard
+// pattern such as "/captures/jupiter_*.tif". Frames are ordered by the
+// numbers in their names, or by modification time if names carry none.
+// Every frame is a file of its own, so frames can be decoded concurrently.
+class ImageSequence {
+public:
+    explicit ImageSequence(const QString &path);
+
+    static bool isSequencePath(const QString &path);
+
+    bool isValid() const { return !_paths.isEmpty() && _dimensions.area() > 0; }
+    int frames() const { return static_cast<int>(_paths.size()); }
+    cv::Size dimensions() const { return _dimensions; }
+    qint64 size() const { return _size; }
+
+    cv::Mat frame(int index) const;
+    QString path(int index) const { return _paths.value(index); }
+    const QStringList &paths() const { return _paths; }
+
+private:
+    QStringList _paths;
+    cv::Size _dimensions = {0, 0};
+    qint64 _size = 0;
+};
+
+#endif // IMAGE_SEQUENCE_H
@@ -2,26 +2,48 @@
 
 void MediaCollection::addFile(MediaFile *file) {
     _files.push_back(file);
-    _totalFrames += file->frames();
+    _updateOffsets();
 }
 
 void MediaCollection::removeFile(MediaFile *file) {
     for (auto it = _files.begin(); it != _files.end(); ++it) {
         if (*it == file) {
-            _totalFrames -= (*it)->frames();
             _files.erase(it);
+            _updateOffsets();
             return;
         }
     }
 }
 
+std::pair<int, int> MediaCollection::locate(int frame) const {
+    if (frame < 0 || frame >= totalFrames()) {
+        return {-1, -1};
+    }
+
+    // Last file starting at or before 'frame' (skips empty files)
+    auto it = std::upper_bound(_offsets.begin(), _offsets.end(), frame);
+    int file = static_cast<int>(it - _offsets.begin()) - 1;
+    return {file, frame - _offsets[file]};
+}
+
 cv::Mat MediaCollection::matAtFrame(int frame) {
-    int currentFrame = 0;
-    for (int i = 0; i < _files.size(); ++i) {
-        if (frame < currentFrame + _files[i]->frames()) {
-            return _files[i]->matAtFrame(frame - currentFrame);
-        }
-        currentFrame += _files[i]->frames();
+    auto [file, local] = locate(frame);
+    if (file < 0) {
+        return {};
+    }
+    return _files[file]->matAtFrame(local);
+}
+
+void MediaCollection::cacheFrame(int frame, const cv::Mat &mat, double priority) {
+    auto [file, local] = locate(frame);
+    if (file >= 0) {
+        _files[file]->cacheFrame(local, mat, priority);
+    }
+}
+
+void MediaCollection::_updateOffsets() {
+    _offsets.assign(1, 0);
+    for (const auto *file : _files) {
+        _offsets.push_back(_offsets.back() + file->frames());
     }
-    return {};
 }
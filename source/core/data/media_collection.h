@@ -9,11 +9,16 @@ public:
     ~MediaCollection() = default;
 
     cv::Mat matAtFrame(int frame);
-    std::vector<cv::Mat> matsAtFrames(std::vector<int> &frames) { return {}; }
+    void cacheFrame(int frame, const cv::Mat &mat, double priority = 0.0);
     bool allDimensionsEqual() const { return true; }
-    int totalFrames() const { return _totalFrames; }
+    int totalFrames() const { return _offsets.back(); }
     int fileCount() const { return static_cast<int>(_files.size()); }
 
+    // (file, frame within the file) of global 'frame', file is -1 if out of range
+    std::pair<int, int> locate(int frame) const;
+    // First global frame of 'file'
+    int fileOffset(int file) const { return _offsets[file]; }
+
     void addFile(MediaFile *file);
     void removeFile(MediaFile *file);
 
@@ -23,7 +28,10 @@ public:
 
 private:
     std::vector<MediaFile *> _files;
-    int _totalFrames = 0;
+    // Prefix sums of frame counts, _offsets[i] is the first global frame of _files[i]
+    std::vector<int> _offsets{0};
+
+    void _updateOffsets();
 };
 
 #endif // MEDIA_COLLECTION_H
@@ -1,103 +1,467 @@
 #include "media_file.h"
+#include "data/frame_cache.h"
 #include <QFileInfo>
+#include <QImageReader>
+#include <thread>
 
 MediaFile::MediaFile(const QString &filename) {
     QFileInfo file(filename);
     QString extension = filename.mid(filename.lastIndexOf('.'));
     _filename = file.completeBaseName().toStdString();
     _path = filename.toStdString();
+    _size = file.size();
 
-    if (imageExtensions.contains(extension)) {
-        image = cv::imread(filename.toStdString());
-        if (!image.empty()) {
+    if (extension == ".avi") {
+        // Uncompressed captures are read straight from the file, others need a decoder
+        avi = std::make_unique<AviFile>(filename);
+        if (!avi->isValid()) {
+            avi.reset();
+        }
+    }
+
+    if (ImageSequence::isSequencePath(filename)) {
+        sequence = std::make_unique<ImageSequence>(filename);
+        if (sequence->isValid()) {
+            _frames = sequence->frames();
+            _isVideo = true;
+            _isValid = true;
+            _dimensions = sequence->dimensions();
+            _size = sequence->size();
+
+            // Frames are independent files, decode as many at once as videos use decoders
+            _maxDecoders = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+        }
+
+        if (file.isDir()) {
+            _filename = file.fileName().toStdString();
+            extension.clear();
+        }
+    }
+    else if (fitsExtensions.contains(extension)) {
+        fits = std::make_unique<FitsFile>(filename);
+        if (fits->isValid()) {
+            _frames = fits->frames();
+            _isVideo = _frames > 1;
+            _isValid = true;
+            _dimensions = fits->dimensions();
+            _bayerPattern = Bayer::patternFromName(fits->bayerPattern());
+        }
+    }
+    else if (imageExtensions.contains(extension)) {
+        // Only the header is read here, pixels are decoded on first access
+        QImageReader reader(filename);
+        QSize size = reader.size();
+        if (size.isValid()) {
+            _dimensions = {size.width(), size.height()};
+        }
+        else {
+            // Format without a header-only reader, decode once just to probe it
+            _dimensions = cv::imread(filename.toStdString()).size();
+        }
+
+        if (_dimensions.area() > 0) {
             _frames = 1;
             _isValid = true;
-            _dimensions = image.size();
         }
     }
+    else if (extension == ".ser") {
+        ser = std::make_unique<SerFile>(filename);
+        if (ser->isValid()) {
+            _frames = ser->frames();
+            _isVideo = true;
+            _isValid = true;
+            _dimensions = ser->dimensions();
+
+            switch (ser->colorId()) {
+            case SerFile::ColorId::BayerRGGB:
+                _bayerPattern = Bayer::Pattern::RGGB;
+                break;
+            case SerFile::ColorId::BayerGRBG:
+                _bayerPattern = Bayer::Pattern::GRBG;
+                break;
+            case SerFile::ColorId::BayerGBRG:
+                _bayerPattern = Bayer::Pattern::GBRG;
+                break;
+            case SerFile::ColorId::BayerBGGR:
+                _bayerPattern = Bayer::Pattern::BGGR;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    else if (avi) {
+        _frames = avi->frames();
+        _isVideo = true;
+        _isValid = true;
+        _dimensions = avi->dimensions();
+    }
     else {
-        video = cv::VideoCapture(filename.toStdString());
-        if (video.isOpened()) {
-            _frames = video.get(cv::CAP_PROP_FRAME_COUNT);
+        // Leave half of the cores to the threads consuming decoded frames
+        _maxDecoders = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2);
+
+        // Exact frame count and keyframes, CAP_PROP_FRAME_COUNT is unreliable for some containers
+        index = std::make_unique<FrameIndex>(FrameIndex::open(filename));
+
+        auto decoder = _openDecoder();
+        if (decoder) {
+            cv::VideoCapture &video = decoder->capture;
+            _frames = index->isValid() ? index->frames() : video.get(cv::CAP_PROP_FRAME_COUNT);
             _isVideo = true;
             _isValid = true;
             _dimensions = cv::Size(video.get(cv::CAP_PROP_FRAME_WIDTH), video.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+            // The probing decoder becomes the first one of the pool
+            ++openDecoders;
+            decoders.push_back(std::move(decoder));
         }
     }
     _extension = extension.toStdString();
 }
 
+//
+// Returns 'mat' multiplied by 'scale', see 'sampleScale()'.
+//
+static cv::Mat fullRange(const cv::Mat &mat, int scale) {
+    if (scale == 1 || mat.empty()) {
+        return mat;
+    }
+    cv::Mat result;
+    mat.convertTo(result, mat.type(), scale);
+    return result;
+}
+
+//
+// Returns 'frame' ready for display, raw captures are debayered.
+//
 cv::Mat MediaFile::matAtFrame(int frame) {
+    cv::Mat buffer;
+    cv::Mat mat = readFrame(frame, buffer);
+
+    // Random access is what makes decoding expensive, keep the frame around
+    cacheFrame(frame, mat);
+
+    // Interactive reads favour speed, stacking picks its own method
+    cv::Mat color;
+    return fullRange(Bayer::debayer(mat, _bayerPattern, Bayer::Method::Bilinear, color), sampleScale());
+}
+
+//
+// Returns the first frame reduced to 'height' (never enlarged), for previews.
+//
+// Still images, alone or in sequences, are decoded by Qt straight at the
+// reduced size, which most formats do much faster than a full decode.
+// Nothing is cached: a preview isn't a sign that full frames will follow.
+//
+cv::Mat MediaFile::thumbnail(int height) {
+    QString path = sequence ? sequence->path(0) : QString::fromStdString(_path);
+    bool still = sequence || (!_isVideo && !_isMapped());
+
+    if (still && !fitsExtensions.contains("." + QFileInfo(path).suffix().toLower())) {
+        QImageReader reader(path);
+        QSize size = reader.size();
+        if (size.isValid() && size.height() > height) {
+            reader.setScaledSize({std::max(1, size.width() * height / size.height()), height});
+        }
+
+        QImage image = reader.read();
+        if (!image.isNull()) {
+            image = image.convertToFormat(QImage::Format_RGB888);
+            cv::Mat rgb(image.height(), image.width(), CV_8UC3, image.bits(), image.bytesPerLine());
+            cv::Mat bgr;
+            cv::cvtColor(rgb, bgr, cv::COLOR_RGB2BGR);
+            return bgr;
+        }
+    }
+
+    cv::Mat buffer, color;
+    cv::Mat frame = fullRange(Bayer::debayer(readFrame(0, buffer), _bayerPattern, Bayer::Method::Bilinear, color), sampleScale());
+    if (frame.rows <= height) {
+        return frame.clone();
+    }
+
+    cv::Mat result;
+    double scale = static_cast<double>(height) / frame.rows;
+    cv::resize(frame, result, {}, scale, scale, cv::INTER_AREA);
+    return result;
+}
+
+//
+// Returns 'frame', decoding it into 'buffer' if decoding is needed.
+//
+// 'buffer' is reused as long as its size and type match the frame,
+// so callers reading many frames can avoid per-frame allocations.
+// The result is either 'buffer' or a view of memory owned by the file
+// and must not be modified in place.
+//
+cv::Mat MediaFile::readFrame(int frame, cv::Mat &buffer) {
+    // Mapped frames need neither decoding nor locking
+    if (ser) {
+        return ser->frame(frame);
+    }
+    if (fits) {
+        return fits->frame(frame);
+    }
+    if (avi) {
+        return avi->frame(frame);
+    }
+
+    if (sequence) {
+        cv::Mat cached;
+        if (FrameCache::shared().find(this, frame, cached)) {
+            return cached;
+        }
+        return sequence->frame(frame);
+    }
+
     if (_isVideo) {
-        std::lock_guard<std::mutex> lock(videoMutex);
+        cv::Mat cached;
+        if (FrameCache::shared().find(this, frame, cached)) {
+            return cached;
+        }
+
+        DecoderLease lease = leaseDecoder(frame);
+        return lease._decoder ? lease._decoder->read(frame, buffer) : cv::Mat();
+    }
+
+    // Still images aren't kept by the file, only by the frame cache
+    cv::Mat cached;
+    if (FrameCache::shared().find(this, frame, cached)) {
+        return cached;
+    }
+
+    buffer = cv::imread(_path);
+    return buffer;
+}
+
+//
+// Leases a decoder for exclusive use, preferring the one positioned right
+// before 'nextFrame' so that reading it needs no seek.
+//
+// A new decoder is opened if none is idle and the pool is not full,
+// otherwise the call blocks until another lease is returned. The lease
+// holds no decoder if the video can't be opened at all, reads through it
+// return empty frames then.
+//
+MediaFile::DecoderLease MediaFile::leaseDecoder(int nextFrame) {
+    // Only videos have decoders, sequence frames are read from their own files
+    if (!_isVideo || _isMapped() || sequence) {
+        return {this, nullptr};
+    }
+    return {this, _acquireDecoder(nextFrame)};
+}
+
+std::unique_ptr<MediaFile::Decoder> MediaFile::_acquireDecoder(int nextFrame) {
+    std::unique_lock<std::mutex> lock(decodersMutex);
+
+    while (true) {
+        if (!decoders.empty()) {
+            // Exact continuation first, then the smallest forward skip, then anything
+            auto best = decoders.begin();
+            for (auto it = decoders.begin(); it != decoders.end(); ++it) {
+                int previous = (*it)->previousFrame;
+                int bestPrevious = (*best)->previousFrame;
+                bool forward = previous < nextFrame;
+                bool bestForward = bestPrevious < nextFrame;
+                if ((forward && !bestForward) || (forward && bestForward && previous > bestPrevious)) {
+                    best = it;
+                }
+            }
 
-        if (frame != previousFrame + 1) {
-            video.set(cv::CAP_PROP_POS_FRAMES, frame);
+            // Even a distant decoder only needs a seek, which a fresh one would
+            // need as well, on top of opening the file
+            auto decoder = std::move(*best);
+            decoders.erase(best);
+            return decoder;
         }
 
-        cv::Mat mat;
-        if (video.read(mat)) {
-            previousFrame = frame;
-            return mat;
+        if (openDecoders < _maxDecoders && !openFailed) {
+            ++openDecoders;
+            lock.unlock();
+
+            auto decoder = _openDecoder();
+            if (decoder) {
+                return decoder;
+            }
+
+            // The pool stops growing, the file won't open any better next time
+            lock.lock();
+            --openDecoders;
+            openFailed = true;
         }
-        else {
-            return {};
+
+        // Nothing to wait for, no lease will ever be returned
+        if (openDecoders == 0) {
+            return nullptr;
         }
+
+        decoderReleased.wait(lock, [this] { return !decoders.empty(); });
     }
+}
 
-    return image;
+void MediaFile::_releaseDecoder(std::unique_ptr<Decoder> decoder) {
+    {
+        std::lock_guard<std::mutex> lock(decodersMutex);
+        decoders.push_back(std::move(decoder));
+    }
+    decoderReleased.notify_one();
 }
 
-std::vector<cv::Mat> MediaFile::matsAtFrames(std::vector<int> &frames) {
-    if (!_isVideo) {
-        return {image};
+std::unique_ptr<MediaFile::Decoder> MediaFile::_openDecoder() {
+    auto decoder = std::make_unique<Decoder>();
+
+    // Pooled decoders run side by side, split the cores between them
+    // instead of letting each one spawn a thread per core
+    int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / _maxDecoders);
+    if (!decoder->capture.open(_path, cv::CAP_ANY, {cv::CAP_PROP_N_THREADS, threads})) {
+        // Backend doesn't accept the thread hint
+        decoder->capture.open(_path);
+    }
+
+    if (!decoder->capture.isOpened()) {
+        return nullptr;
+    }
+
+    if (index && index->hasKeyframes()) {
+        decoder->index = index.get();
     }
+    return decoder;
+}
 
-    if (!frames.size()) {
+cv::Mat MediaFile::Decoder::read(int frame, cv::Mat &buffer) {
+    if (frame != previousFrame + 1 && !seek(frame)) {
+        previousFrame = -1;
         return {};
     }
 
-    std::lock_guard<std::mutex> lock(videoMutex);
-    video.set(cv::CAP_PROP_POS_FRAMES, 0);
+    if (capture.read(buffer)) {
+        previousFrame = frame;
+        return buffer;
+    }
 
-    int target = 0;
-    int targetIndex = frames[target];
-    int current = 0;
+    previousFrame = -1;
+    return {};
+}
 
-    cv::Mat frame;
-    std::vector<cv::Mat> result;
+//
+// Positions the decoder so that the next read returns 'frame'.
+//
+// With a keyframe index, the decoder jumps to the last keyframe before 'frame'
+// and grabs forward from there. If it's already between that keyframe and
+// 'frame', it just grabs forward. Without one, it jumps to 'frame' itself
+// unless it's a few frames ahead. Jumps still go through the backend's seek,
+// the index only bounds how far the decoder grabs after it.
+//
+// Grabbing skips the color conversion and copy of a full read, so passing
+// over unneeded frames stays cheap.
+//
+bool MediaFile::Decoder::seek(int frame) {
+    // Without keyframes, short forward gaps are still cheaper to grab through than to seek
+    constexpr int maxGrabGap = 16;
 
-    while (video.read(frame)) {
-        if (current == targetIndex) {
-            result.push_back(frame.clone());
-            ++target;
+    int position = previousFrame + 1;
+    int keyframe = index ? index->keyframeBefore(frame) : -1;
+    if (keyframe < 0) {
+        keyframe = previousFrame < 0 || position > frame || frame - position > maxGrabGap ? frame : position;
+    }
 
-            if (target >= frames.size()) {
-                break;
-            }
+    if (previousFrame < 0 || position > frame || position < keyframe) {
+        position = jump(keyframe);
+        if (position < 0) {
+            return false;
+        }
+    }
 
-            targetIndex = frames[target];
+    for (; position < frame; ++position) {
+        if (!capture.grab()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// Seeks the backend to 'frame', and returns the position it actually
+// reached, at or before 'frame', or -1 if it can't get there.
+//
+// Backends seeking by frame number can land a frame or more off. Landing
+// early is made up by grabbing, landing late is retried from the previous
+// keyframe (or further back, without an index).
+//
+int MediaFile::Decoder::jump(int frame) {
+    constexpr int backoff = 16;
+
+    int target = frame;
+    while (true) {
+        capture.set(cv::CAP_PROP_POS_FRAMES, target);
+        int reached = cvRound(capture.get(cv::CAP_PROP_POS_FRAMES));
+        if (reached >= 0 && reached <= frame) {
+            return reached;
+        }
+        if (target == 0) {
+            return -1;
         }
 
-        ++current;
+        int keyframe = index ? index->keyframeBefore(target - 1) : -1;
+        target = keyframe >= 0 ? keyframe : std::max(0, target - backoff);
     }
+}
 
-    return result;
+MediaFile::DecoderLease::~DecoderLease() {
+    if (_decoder) {
+        _file->_releaseDecoder(std::move(_decoder));
+    }
 }
 
-MediaFile::~MediaFile() {
-    if (_isVideo) {
-        video.release();
+//
+// Same as MediaFile::readFrame(), but decodes with the leased decoder.
+//
+cv::Mat MediaFile::DecoderLease::read(int frame, cv::Mat &buffer) {
+    if (!_decoder) {
+        return _file->readFrame(frame, buffer);
+    }
+
+    cv::Mat cached;
+    if (FrameCache::shared().find(_file, frame, cached)) {
+        return cached;
     }
+
+    return _decoder->read(frame, buffer);
+}
+
+//
+// Offers decoded 'frame' to the shared frame cache.
+//
+// Only frames that are expensive to get again (decoded video and images)
+// are cached, mapped frames are already in memory.
+//
+void MediaFile::cacheFrame(int frame, const cv::Mat &mat, double priority) {
+    if (_isMapped()) {
+        return;
+    }
+    FrameCache::shared().insert(this, frame, mat, priority);
+}
+
+MediaFile::~MediaFile() {
+    FrameCache::shared().erase(this);
 }
 
 MediaFile::MediaFile(MediaFile&& other) noexcept {
-    image = std::move(other.image);
-    video = std::move(other.video);
+    ser = std::move(other.ser);
+    fits = std::move(other.fits);
+    avi = std::move(other.avi);
+    sequence = std::move(other.sequence);
+    index = std::move(other.index);
+    decoders = std::move(other.decoders);
+    openDecoders = other.openDecoders;
+    openFailed = other.openFailed;
+    _maxDecoders = other._maxDecoders;
     _isValid = other._isValid;
     _isVideo = other._isVideo;
     _frames = other._frames;
     _dimensions = other._dimensions;
+    _size = other._size;
+    _bayerPattern = other._bayerPattern;
     _extension = std::move(other._extension);
     _filename = std::move(other._filename);
     _path = std::move(other._path);
@@ -105,12 +469,21 @@ MediaFile::MediaFile(MediaFile&& other) noexcept {
 
 MediaFile& MediaFile::operator=(MediaFile&& other) noexcept {
     if (this != &other) {
-        image = std::move(other.image);
-        video = std::move(other.video);
+        ser = std::move(other.ser);
+        fits = std::move(other.fits);
+        avi = std::move(other.avi);
+        sequence = std::move(other.sequence);
+        index = std::move(other.index);
+        decoders = std::move(other.decoders);
+        openDecoders = other.openDecoders;
+        openFailed = other.openFailed;
+        _maxDecoders = other._maxDecoders;
         _isValid = other._isValid;
         _isVideo = other._isVideo;
         _frames = other._frames;
         _dimensions = other._dimensions;
+        _size = other._size;
+        _bayerPattern = other._bayerPattern;
         _extension = std::move(other._extension);
         _filename = std::move(other._filename);
         _path = std::move(other._path);
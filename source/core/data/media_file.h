@@ -3,21 +3,41 @@
 
 #include <opencv2/opencv.hpp>
 #include <QSet>
+#include <condition_variable>
+#include "data/ser_file.h"
+#include "data/fits_file.h"
+#include "data/avi_file.h"
+#include "data/frame_index.h"
+#include "data/image_sequence.h"
+#include "components/bayer.h"
+
+// How frames are handed to stream consumers
+enum class ReadMode {
+    Native, // As stored: BGR, mono or raw mosaic, at the file's bit depth
+    Luma    // 8-bit single channel luminance, see Frame::luma()
+};
 
 // Allowed image extensions
 const QSet<QString> imageExtensions = {
-    ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff"
+    ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".fits", ".fit", ".fts"
+};
+
+// FITS extensions (single images and cubes)
+const QSet<QString> fitsExtensions = {
+    ".fits", ".fit", ".fts"
 };
 
 // Allowed video extensions
 const QSet<QString> videoExtensions = {
-    ".mp4", ".avi", ".mkv", ".mov"
+    ".mp4", ".avi", ".mkv", ".mov", ".ser"
 };
 
-// Represents a single media file (video or image)
+// Represents a single media file (video, image or image sequence)
 // and provides ability to extract specific frames from it
 class MediaFile {
 public:
+    class DecoderLease;
+
     MediaFile(const QString &filename);
     ~MediaFile();
 
@@ -25,11 +45,24 @@ public:
     bool isVideo() const { return _isVideo; };
     int frames() const { return _frames; };
     cv::Size dimensions() const { return _dimensions; }
+    // Color filter of raw captures, frames read with 'readFrame()' are mosaics then
+    Bayer::Pattern bayerPattern() const { return _bayerPattern; }
+    // Factor that brings frames read with 'readFrame()' to the full range of
+    // their type, other than 1 for LSB-aligned SER captures only.
+    // 'matAtFrame()' and 'thumbnail()' apply it.
+    int sampleScale() const { return ser ? ser->scale() : 1; }
     std::string extension() const { return _extension; }
     std::string filename() const { return _filename; }
     std::string path() const { return _path; }
+    // Size on disk, in bytes
+    qint64 size() const { return _size; }
     cv::Mat matAtFrame(int frame);
-    std::vector<cv::Mat> matsAtFrames(std::vector<int> &frames);
+    cv::Mat thumbnail(int height);
+    cv::Mat readFrame(int frame, cv::Mat &buffer);
+    void cacheFrame(int frame, const cv::Mat &mat, double priority = 0.0);
+
+    DecoderLease leaseDecoder(int nextFrame = -1);
+    int maxDecoders() const { return _maxDecoders; }
 
     MediaFile(MediaFile &&other) noexcept;
     MediaFile& operator=(MediaFile &&other) noexcept;
@@ -40,19 +73,69 @@ public:
     bool operator<(const MediaFile &other) { return _path < other._path; }
 
 private:
-    cv::Mat image;
-    cv::VideoCapture video;
+    // Independent video decoder with its own read position
+    struct Decoder {
+        cv::VideoCapture capture;
+        const FrameIndex *index = nullptr;
+        int previousFrame = -1;
+        cv::Mat read(int frame, cv::Mat &buffer);
+        bool seek(int frame);
+        int jump(int frame);
+    };
+
+    std::unique_ptr<SerFile> ser;
+    std::unique_ptr<FitsFile> fits;
+    std::unique_ptr<AviFile> avi;
+    std::unique_ptr<ImageSequence> sequence;
+    bool _isMapped() const { return ser || fits || avi; }
+    std::unique_ptr<FrameIndex> index;
+
+    // Pool of video decoders, idle ones are kept in 'decoders'
+    std::vector<std::unique_ptr<Decoder>> decoders;
+    int openDecoders = 0;
+    bool openFailed = false;
+    int _maxDecoders = 1;
+    std::mutex decodersMutex;
+    std::condition_variable decoderReleased;
+
+    std::unique_ptr<Decoder> _openDecoder();
+    std::unique_ptr<Decoder> _acquireDecoder(int nextFrame);
+    void _releaseDecoder(std::unique_ptr<Decoder> decoder);
 
     bool _isValid = false;
     bool _isVideo = false;
     int _frames = 0;
     cv::Size _dimensions = {0, 0};
+    qint64 _size = 0;
+    Bayer::Pattern _bayerPattern = Bayer::Pattern::None;
     std::string _extension;
     std::string _filename;
     std::string _path;
+};
+
+// Exclusive use of one of the file's video decoders, returned to the pool on destruction.
+//
+// A worker that walks a contiguous range of frames through its own lease
+// reads sequentially and never competes with other workers for a decoder.
+// Leases of still images and mapped files read straight from the file,
+// as do leases of videos that can't be opened, which read nothing.
+class MediaFile::DecoderLease {
+public:
+    DecoderLease(MediaFile *file, std::unique_ptr<Decoder> decoder)
+        : _file(file), _decoder(std::move(decoder)) {}
+    ~DecoderLease();
+
+    cv::Mat read(int frame, cv::Mat &buffer);
+
+    DecoderLease(DecoderLease &&other) = default;
+    DecoderLease(const DecoderLease &) = delete;
+    DecoderLease& operator=(const DecoderLease &) = delete;
+
+private:
+    friend class MediaFile;
 
-    std::mutex videoMutex;
-    int previousFrame = -1;
+    MediaFile *_file;
+    std::unique_ptr<Decoder> _decoder;
 };
 
 #endif // MEDIA_FILE_H
@@ -0,0 +1,166 @@
+#include "ser_file.h"
+#include <QtEndian>
+#include <cstring>
+
+//
+// Opens and maps the SER file at 'path'.
+//
+// Header layout (178 bytes, little-endian):
+// - 0:   "LUCAM-RECORDER" file ID;
+// - 18:  color ID;
+// - 26:  width, 30: height;
+// - 34:  bit depth per plane;
+// - 38:  frame count.
+//
+// Frame data follows the header, optionally followed by a trailer
+// of 64-bit timestamps (one per frame).
+//
+// Truncated captures are accepted, the frame count is clamped to
+// the number of complete frames in the file.
+//
+SerFile::SerFile(const QString &path) : _file(path) {
+    if (!_file.open(QIODevice::ReadOnly) || _file.size() < headerSize) {
+        return;
+    }
+
+    // Private mapping: accidental writes to a frame never reach the disk
+    uchar *data = _file.map(0, _file.size(), QFileDevice::MapPrivateOption);
+    if (!data) {
+        return;
+    }
+
+    if (std::memcmp(data, "LUCAM-RECORDER", 14) != 0) {
+        _file.unmap(data);
+        return;
+    }
+
+    auto field = [data](int offset) {
+        return qFromLittleEndian<qint32>(data + offset);
+    };
+
+    int colorId = field(18);
+    int width = field(26);
+    int height = field(30);
+    _bitDepth = field(34);
+    int frames = field(38);
+
+    int planes = 0;
+    switch (colorId) {
+    case static_cast<int>(ColorId::Mono):
+    case static_cast<int>(ColorId::BayerRGGB):
+    case static_cast<int>(ColorId::BayerGRBG):
+    case static_cast<int>(ColorId::BayerGBRG):
+    case static_cast<int>(ColorId::BayerBGGR):
+        planes = 1;
+        break;
+    case static_cast<int>(ColorId::RGB):
+    case static_cast<int>(ColorId::BGR):
+        planes = 3;
+        break;
+    default:
+        // CMY(G) mosaics are not supported
+        break;
+    }
+
+    if (planes == 0 || width <= 0 || height <= 0 || _bitDepth <= 0 || _bitDepth > 16 || frames <= 0) {
+        _file.unmap(data);
+        return;
+    }
+
+    // Samples deeper than 8 bits are stored as 16-bit little-endian words.
+    // The header's endianness flag is ignored: capture software is known to
+    // set it inconsistently, while the data itself is always little-endian.
+    int depth = _bitDepth > 8 ? CV_16U : CV_8U;
+    _type = CV_MAKETYPE(depth, planes);
+    _colorId = static_cast<ColorId>(colorId);
+    _dimensions = {width, height};
+    _frameBytes = static_cast<qint64>(width) * height * planes * (_bitDepth > 8 ? 2 : 1);
+
+    qint64 available = (_file.size() - headerSize) / _frameBytes;
+    _frames = static_cast<int>(std::min<qint64>(frames, available));
+    if (_frames == 0) {
+        _file.unmap(data);
+        return;
+    }
+
+    // Timestamp trailer is only trusted if the capture is complete
+    qint64 trailerOffset = headerSize + _frameBytes * frames;
+    if (_frames == frames && _file.size() >= trailerOffset + frames * static_cast<qint64>(sizeof(qint64))) {
+        _timestamps = data + trailerOffset;
+    }
+
+    _data = data;
+
+    // The format stores samples LSB-aligned, the pipeline expects the full
+    // 16-bit range. Some capture software writes them MSB-aligned anyway,
+    // which leaves the low (16 - depth) bits of every sample zero.
+    if (_bitDepth > 8 && _bitDepth < 16 && !_isMsbAligned()) {
+        _scale = 1 << (16 - _bitDepth);
+    }
+}
+
+//
+// Returns true if the low (16 - depth) bits of the samples are zero in
+// a few frames spread over the capture. Sensor noise sets them in
+// practically every frame of LSB-aligned data, while values alone can't
+// tell alignments apart (a dark MSB-aligned frame stays below 2^depth).
+//
+bool SerFile::_isMsbAligned() const {
+    constexpr int sampledFrames = 4;
+    const quint16 lowBits = static_cast<quint16>((1 << (16 - _bitDepth)) - 1);
+    const qint64 samples = _frameBytes / 2;
+
+    quint16 used = 0;
+    for (int i = 0; i < sampledFrames; ++i) {
+        qint64 index = static_cast<qint64>(_frames - 1) * i / std::max(1, sampledFrames - 1);
+        const uchar *frame = _data + headerSize + _frameBytes * index;
+        for (qint64 j = 0; j < samples; ++j) {
+            used |= qFromLittleEndian<quint16>(frame + 2 * j);
+            if (used & lowBits) {
+                return false;
+            }
+        }
+    }
+
+    // Blank captures look the same either way
+    return used != 0;
+}
+
+SerFile::~SerFile() {
+    if (_data) {
+        _file.unmap(_data);
+    }
+}
+
+//
+// Returns frame 'index' as a view into the mapping.
+//
+// RGB-ordered captures are the only ones that need a copy, as the rest of
+// the pipeline expects BGR. Samples are as stored, see 'scale()'.
+//
+cv::Mat SerFile::frame(int index) const {
+    if (!_data || index < 0 || index >= _frames) {
+        return {};
+    }
+
+    cv::Mat mat(_dimensions, _type, _data + headerSize + _frameBytes * index);
+
+    if (_colorId == ColorId::RGB) {
+        cv::Mat bgr;
+        cv::cvtColor(mat, bgr, cv::COLOR_RGB2BGR);
+        return bgr;
+    }
+
+    return mat;
+}
+
+//
+// Returns the capture time of frame 'index' in 100 ns ticks since 0001-01-01 (UTC),
+// or 0 if the file has no timestamp trailer.
+//
+qint64 SerFile::timestamp(int index) const {
+    if (!_timestamps || index < 0 || index >= _frames) {
+        return 0;
+    }
+    return qFromLittleEndian<qint64>(_timestamps + static_cast<qint64>(index) * sizeof(qint64));
+}
@@ -0,0 +1,62 @@
+#ifndef SER_FILE_H
+#define SER_FILE_H
+
+#include <opencv2/opencv.hpp>
+#include <QFile>
+
+// Memory-mapped reader for SER captures (LUCAM-RECORDER format).
+//
+// Frames are returned as cv::Mat headers pointing straight into the mapping,
+// so random access is a pointer computation and needs no locking.
+class SerFile {
+public:
+    enum class ColorId {
+        Mono = 0,
+        BayerRGGB = 8,
+        BayerGRBG = 9,
+        BayerGBRG = 10,
+        BayerBGGR = 11,
+        RGB = 100,
+        BGR = 101
+    };
+
+    explicit SerFile(const QString &path);
+    ~SerFile();
+
+    bool isValid() const { return _data != nullptr; }
+    int frames() const { return _frames; }
+    cv::Size dimensions() const { return _dimensions; }
+    int type() const { return _type; }
+    int bitDepth() const { return _bitDepth; }
+    // Factor that brings samples to the full range of their type, left to
+    // readers so that frames stay views into the mapping
+    int scale() const { return _scale; }
+    ColorId colorId() const { return _colorId; }
+    bool hasTimestamps() const { return _timestamps != nullptr; }
+
+    cv::Mat frame(int index) const;
+    qint64 timestamp(int index) const;
+
+    SerFile(const SerFile &) = delete;
+    SerFile& operator=(const SerFile &) = delete;
+
+private:
+    static constexpr qint64 headerSize = 178;
+
+    QFile _file;
+    uchar *_data = nullptr;
+    const uchar *_timestamps = nullptr;
+
+    int _frames = 0;
+    cv::Size _dimensions = {0, 0};
+    int _type = CV_8UC1;
+    int _bitDepth = 8;
+    // 1 << (16 - depth) for LSB-aligned samples of 9 to 15 bits
+    int _scale = 1;
+    ColorId _colorId = ColorId::Mono;
+    qint64 _frameBytes = 0;
+
+    bool _isMsbAligned() const;
+};
+
+#endif // SER_FILE_H
@@ -1,9 +1,10 @@
 #include "image_processor.h"
+#include "components/frame.h"
 
 void ImageProcessor::load(cv::Mat mat) {
     // Convert to CV_32F for better precision
     if (mat.depth() != CV_32F) {
-        mat.convertTo(original, CV_32F, 1.0 / 255.0);
+        mat.convertTo(original, CV_32F, Frame::to8BitScale(mat.depth()) / 255.0);
     }
     else {
         original = mat;
@@ -1,42 +1,23 @@
 #include "alignment.h"
+#include "components/frame.h"
+#include "stacking/phase_correlator.h"
 
-cv::Point2f computeShift(cv::Mat reference, cv::Mat target, double confidence) {
-    // Ensure input images are 32F grayscale
-    cv::Mat refGray, tgtGray;
-    if (reference.channels() > 1) {
-        cv::cvtColor(reference, refGray, cv::COLOR_BGR2GRAY);
-    }
-    else {
-        refGray = reference.clone();
-    }
+cv::Point2f computeShift(cv::Mat reference, cv::Mat target, double confidence, double *response) {
+    // Single use: the reference transform isn't worth keeping
+    PhaseCorrelator correlator(reference, {0, 0, reference.cols, reference.rows});
 
-    if (target.channels() > 1) {
-        cv::cvtColor(target, tgtGray, cv::COLOR_BGR2GRAY);
+    double peak = 0.0;
+    cv::Point2f shift = correlator.shift(target, {0, 0}, &peak);
+    if (response) {
+        *response = peak;
     }
-    else {
-        tgtGray = target.clone();
-    }
-
-    refGray.convertTo(refGray, CV_32F);
-    tgtGray.convertTo(tgtGray, CV_32F);
-
-    // Apply Hanning window to both images
-    cv::Mat hann;
-    cv::createHanningWindow(hann, refGray.size(), CV_32F);
-    refGray = refGray.mul(hann);
-    tgtGray = tgtGray.mul(hann);
-
-    // Perform phase correlation
-    cv::Point2d shift;
-    double response = 0.0;
-    shift = cv::phaseCorrelate(refGray, tgtGray, hann, &response);
 
     // Check if the response is strong enough
-    if (response < confidence) {
+    if (peak < confidence) {
         return cv::Point2f(0, 0);
     }
 
-    return cv::Point2f(static_cast<float>(shift.x), static_cast<float>(shift.y));
+    return shift;
 }
 
 //
@@ -50,7 +31,17 @@ AlignmentPointSet AlignmentPointSet::estimate(cv::Mat frame, Config config) {
     AlignmentPointSet set;
 
     cv::Mat processed;
-    cv::cvtColor(frame, processed, cv::COLOR_BGR2GRAY);
+    if (frame.channels() == 3) {
+        cv::cvtColor(frame, processed, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        processed = frame.clone();
+    }
+
+    // Otsu thresholding requires 8-bit data
+    if (processed.depth() != CV_8U) {
+        processed.convertTo(processed, CV_8U, Frame::to8BitScale(processed.depth()));
+    }
 
     std::vector<cv::Point> cvAps;
 
@@ -3,8 +3,24 @@
 
 #include <opencv2/opencv.hpp>
 
-// Computes shift between 'reference' and 'target' with subpixel precision
-cv::Point2f computeShift(cv::Mat reference, cv::Mat target, double confidence = 0.85);
+// How Stacker correlates whole frames: at full resolution, or coarse to fine
+// on a Gaussian pyramid (see PyramidCorrelator), for large frames
+enum class GlobalAlignment {
+    FullFrame,
+    Pyramid
+};
+
+// How alignment points are matched: by phase correlation, by direct block
+// matching (see BlockMatcher), or by whichever is cheaper for the AP size
+enum class LocalAlignment {
+    Automatic,
+    PhaseCorrelation,
+    BlockMatching
+};
+
+// Computes shift between 'reference' and 'target' with subpixel precision,
+// zero if the correlation peak ('response') is below 'confidence'
+cv::Point2f computeShift(cv::Mat reference, cv::Mat target, double confidence = 0.85, double *response = nullptr);
 
 // Single alignment poit
 class AlignmentPoint {
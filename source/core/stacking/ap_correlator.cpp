@@ -0,0 +1,202 @@
+#include "ap_correlator.h"
+#include "stacking/phase_correlator.h"
+#include <opencv2/core/hal/hal.hpp>
+
+// DFT plans for one transform size, reused for every block
+struct Plans {
+    int size = 0;
+    cv::Ptr<cv::hal::DFT2D> forward;
+    cv::Ptr<cv::hal::DFT2D> inverse;
+
+    void prepare(int padded) {
+        if (size == padded) {
+            return;
+        }
+        size = padded;
+        forward = cv::hal::DFT2D::create(padded, padded, CV_32F, 1, 2, cv::DFT_COMPLEX_OUTPUT);
+        inverse = cv::hal::DFT2D::create(padded, padded, CV_32F, 2, 1, cv::DFT_INVERSE | cv::DFT_REAL_OUTPUT);
+    }
+};
+
+// Plans aren't shared between threads, every stacking worker has its own
+static Plans &threadPlans(int padded) {
+    thread_local Plans plans;
+    plans.prepare(padded);
+    return plans;
+}
+
+//
+// Transforms every 'padded' x 'padded' block of 'patches' (real) into
+// the same block of 'spectra' (complex).
+//
+static void forwardBlocks(const cv::Mat &patches, cv::Mat &spectra, int blocks, int padded) {
+    Plans &plans = threadPlans(padded);
+    spectra.create(blocks * padded, padded, CV_32FC2);
+    for (int i = 0; i < blocks; ++i) {
+        cv::Mat src = patches.rowRange(i * padded, (i + 1) * padded);
+        cv::Mat dst = spectra.rowRange(i * padded, (i + 1) * padded);
+        plans.forward->apply(src.data, src.step, dst.data, dst.step);
+    }
+}
+
+//
+// Prepares correlations of 'regions' of 'reference', all of the same size,
+// or block matching within 'radius' pixels, according to 'method'.
+//
+// Regions crossing the border of the reference are left out (their shifts
+// are never confident): clipping them would break the common size, and
+// moving them inside would measure shifts away from where they are applied.
+//
+ApCorrelator::ApCorrelator(const cv::Mat &reference, const std::vector<cv::Rect> &regions, LocalAlignment method, int radius) {
+    if (regions.empty()) {
+        return;
+    }
+
+    _size = regions.front().size();
+    // The window needs at least two pixels per side
+    if (_size.width < 2 || _size.height < 2) {
+        _regions.resize(regions.size());
+        return;
+    }
+
+    const cv::Rect bounds(0, 0, reference.cols, reference.rows);
+    for (const cv::Rect &region : regions) {
+        bool inside = (region & bounds) == region;
+        _regions.push_back(inside && region.size() == _size ? region : cv::Rect());
+    }
+
+    cv::Mat gray;
+    if (reference.channels() > 1) {
+        cv::cvtColor(reference, gray, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        gray = reference;
+    }
+
+    if (method == LocalAlignment::BlockMatching || (method == LocalAlignment::Automatic && BlockMatcher::preferred(_size, radius))) {
+        _matcher = BlockMatcher(gray, _regions, radius);
+    }
+
+    // Spectra are needed with the matcher too, for the points it can't match
+    _padded = cv::getOptimalDFTSize(std::max(_size.width, _size.height));
+    cv::createHanningWindow(_window, _size, CV_32F);
+
+    cv::Mat patches = cv::Mat::zeros(points() * _padded, _padded, CV_32F);
+    for (int i = 0; i < points(); ++i) {
+        _gather(gray, i, {0, 0}, patches.rowRange(i * _padded, (i + 1) * _padded));
+    }
+    forwardBlocks(patches, _spectra, points(), _padded);
+}
+
+//
+// Writes the windowed patch of AP 'point', moved by 'offset', into the top
+// left corner of 'block'. Returns false, leaving 'block' untouched,
+// if there's no such patch in 'gray'.
+//
+bool ApCorrelator::_gather(const cv::Mat &gray, int point, cv::Point offset, cv::Mat block) const {
+    const cv::Rect &region = _regions[point];
+    cv::Rect moved = region + offset;
+    if (region.empty() || (moved & cv::Rect(0, 0, gray.cols, gray.rows)) != moved) {
+        return false;
+    }
+
+    cv::Mat patch = block(cv::Rect(0, 0, _size.width, _size.height));
+    gray(moved).convertTo(patch, CV_32F);
+    cv::multiply(patch, _window, patch);
+    return true;
+}
+
+//
+// Correlates APs 'points' of 'frame', each at its region moved by the same
+// element of 'offsets', writing one result per point to 'results'.
+// Shifts include the offsets. Points whose moved region leaves the frame
+// get a zero response.
+//
+// With a matcher, points are matched first, and only those matched with
+// a response below 'confidence' are phase correlated.
+//
+void ApCorrelator::correlate(const cv::Mat &frame, const std::vector<int> &points, const std::vector<cv::Point> &offsets,
+                             double confidence, std::vector<Result> &results) const {
+    results.assign(points.size(), Result());
+    if (points.empty() || _spectra.empty()) {
+        return;
+    }
+
+    // Per-thread buffers, reused for every frame
+    thread_local cv::Mat gray;
+    thread_local std::vector<int> unmatched, unmatchedPoints;
+    thread_local std::vector<cv::Point> unmatchedOffsets;
+    thread_local std::vector<Result> correlated;
+
+    if (frame.channels() > 1) {
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        gray = frame;
+    }
+
+    if (!matches()) {
+        _phaseCorrelate(gray, points, offsets, results);
+        return;
+    }
+
+    unmatched.clear();
+    unmatchedPoints.clear();
+    unmatchedOffsets.clear();
+    for (int i = 0; i < points.size(); ++i) {
+        results[i].shift = _matcher.match(gray, points[i], offsets[i], &results[i].response);
+        if (results[i].response < confidence) {
+            unmatched.push_back(i);
+            unmatchedPoints.push_back(points[i]);
+            unmatchedOffsets.push_back(offsets[i]);
+        }
+    }
+
+    if (unmatched.empty()) {
+        return;
+    }
+
+    _phaseCorrelate(gray, unmatchedPoints, unmatchedOffsets, correlated);
+    for (int i = 0; i < unmatched.size(); ++i) {
+        results[unmatched[i]] = correlated[i];
+    }
+}
+
+//
+// Phase correlates APs 'points' of 'gray' as a batch, see correlate().
+//
+void ApCorrelator::_phaseCorrelate(const cv::Mat &gray, const std::vector<int> &points,
+                                   const std::vector<cv::Point> &offsets, std::vector<Result> &results) const {
+    // Per-thread buffers, reused for every frame
+    thread_local cv::Mat patches, spectra, references, crossPower, correlation;
+
+    results.assign(points.size(), Result());
+
+    const int blocks = static_cast<int>(points.size());
+    patches.create(blocks * _padded, _padded, CV_32F);
+    patches.setTo(0.0f);
+    references.create(blocks * _padded, _padded, CV_32FC2);
+
+    // Gather the patches, and the matching reference spectra
+    std::vector<bool> gathered(blocks);
+    for (int i = 0; i < blocks; ++i) {
+        cv::Range rows(i * _padded, (i + 1) * _padded);
+        gathered[i] = _gather(gray, points[i], offsets[i], patches.rowRange(rows));
+        _spectra.rowRange(points[i] * _padded, (points[i] + 1) * _padded).copyTo(references.rowRange(rows));
+    }
+
+    forwardBlocks(patches, spectra, blocks, _padded);
+    PhaseCorrelator::crossPowerSpectrum(references, spectra, crossPower);
+
+    Plans &plans = threadPlans(_padded);
+    correlation.create(_padded, _padded, CV_32F);
+    for (int i = 0; i < blocks; ++i) {
+        if (!gathered[i]) {
+            continue;
+        }
+        cv::Mat block = crossPower.rowRange(i * _padded, (i + 1) * _padded);
+        plans.inverse->apply(block.data, block.step, correlation.data, correlation.step);
+
+        results[i].shift = cv::Point2f(offsets[i]) + PhaseCorrelator::peakShift(correlation, &results[i].response);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef AP_CORRELATOR_H
+#define AP_CORRELATOR_H
+
+#include <opencv2/opencv.hpp>
+#include "stacking/alignment.h"
+#include "stacking/block_matcher.h"
+
+// Phase correlation of all alignment points of a frame in one batch.
+//
+// APs share one size, so their patches are laid out back to back in one
+// contiguous buffer, block after block, and transformed with the same
+// reusable DFT plans. Reference spectra are prepared once, at construction.
+// A frame is then gathered, transformed, correlated and searched for peaks
+// without allocating anything per AP once the per-thread buffers are warm.
+//
+// Small APs with small expected shifts are matched directly instead,
+// by a BlockMatcher, which is chosen automatically when it is cheaper.
+// Points the matcher isn't confident about, e.g. moved beyond its search
+// radius, are correlated after all, so its use never narrows the range
+// of shifts that are found.
+class ApCorrelator {
+public:
+    struct Result {
+        cv::Point2f shift;
+        double response = 0.0;
+    };
+
+    ApCorrelator() = default;
+    ApCorrelator(const cv::Mat &reference, const std::vector<cv::Rect> &regions,
+                 LocalAlignment method = LocalAlignment::Automatic, int radius = 4);
+
+    int points() const { return static_cast<int>(_regions.size()); }
+    // False for APs left out, which are never correlated
+    bool covers(int point) const { return !_regions[point].empty(); }
+    bool matches() const { return !_matcher.empty(); }
+
+    void correlate(const cv::Mat &frame, const std::vector<int> &points, const std::vector<cv::Point> &offsets,
+                   double confidence, std::vector<Result> &results) const;
+
+private:
+    // Regions of the reference, all of the AP size, empty if the AP isn't inside it
+    std::vector<cv::Rect> _regions;
+    cv::Size _size;
+    int _padded = 0;
+    cv::Mat _window;
+    // One padded spectrum per AP, stacked vertically
+    cv::Mat _spectra;
+    // Tried before the spectra, if not empty
+    BlockMatcher _matcher;
+
+    bool _gather(const cv::Mat &gray, int point, cv::Point offset, cv::Mat block) const;
+    void _phaseCorrelate(const cv::Mat &gray, const std::vector<int> &points,
+                         const std::vector<cv::Point> &offsets, std::vector<Result> &results) const;
+};
+
+#endif // AP_CORRELATOR_H
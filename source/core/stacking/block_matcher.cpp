@@ -0,0 +1,168 @@
+#include "block_matcher.h"
+#include <opencv2/core/hal/intrin.hpp>
+
+//
+// Returns the dot product of 'a' and 'b', 'length' floats each.
+//
+static float dot(const float *a, const float *b, int length) {
+    float sum = 0.0f;
+    int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes = cv::VTraits<cv::v_float32>::vlanes();
+    cv::v_float32 vSum = cv::vx_setzero_f32();
+    for (; x + lanes <= length; x += lanes) {
+        vSum = cv::v_fma(cv::vx_load(a + x), cv::vx_load(b + x), vSum);
+    }
+    sum = cv::v_reduce_sum(vSum);
+#endif
+    for (; x < length; ++x) {
+        sum += a[x] * b[x];
+    }
+    return sum;
+}
+
+//
+// Returns the offset, within [-0.5, 0.5], of the vertex of the parabola
+// through 'previous', 'peak' and 'next', sampled one apart.
+//
+static double parabolicOffset(double previous, double peak, double next) {
+    double curvature = previous - 2.0 * peak + next;
+    if (curvature >= 0.0) {
+        return 0.0;
+    }
+    return std::clamp(0.5 * (previous - next) / curvature, -0.5, 0.5);
+}
+
+//
+// Prepares matching of 'regions' of 'gray', all of the same size, within
+// 'radius' pixels. Regions that are empty, or flat in the reference, never
+// match.
+//
+BlockMatcher::BlockMatcher(const cv::Mat &gray, const std::vector<cv::Rect> &regions, int radius)
+    : _regions(regions), _radius(std::max(1, radius))
+{
+    auto sized = std::find_if(_regions.begin(), _regions.end(), [](const cv::Rect &region) { return !region.empty(); });
+    if (sized == _regions.end()) {
+        return;
+    }
+
+    _size = sized->size();
+    _patches = cv::Mat::zeros(static_cast<int>(_regions.size()) * _size.height, _size.width, CV_32F);
+    _norms.assign(_regions.size(), 0.0);
+
+    for (int i = 0; i < _regions.size(); ++i) {
+        if (_regions[i].empty()) {
+            continue;
+        }
+        cv::Mat patch = _patches.rowRange(i * _size.height, (i + 1) * _size.height);
+        gray(_regions[i]).convertTo(patch, CV_32F);
+        patch -= cv::mean(patch)[0];
+        _norms[i] = cv::norm(patch);
+    }
+}
+
+//
+// Returns true if matching APs of 'size' within 'radius' is expected to
+// cost less than correlating them.
+//
+// Matching takes one multiply-add per pixel of the patch and displacement,
+// several per SIMD instruction. Correlating takes a forward and an inverse
+// transform of the padded patch, about 2 N log2(N) complex operations (each
+// worth ~4 multiply-adds) for N padded pixels, plus normalizing the
+// cross-power spectrum. APs larger than 48 pixels are left to correlation
+// regardless: they are placed where shifts are larger, and correlation
+// finds those anywhere within half the AP, not only within the radius.
+//
+bool BlockMatcher::preferred(cv::Size size, int radius) {
+    constexpr int maxSize = 48;
+    if (std::max(size.width, size.height) > maxSize) {
+        return false;
+    }
+
+    int lanes = 1;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    lanes = cv::VTraits<cv::v_float32>::vlanes();
+#endif
+    const double side = 2.0 * radius + 1.0;
+    const double matching = side * side * size.area() / lanes;
+
+    const double padded = cv::getOptimalDFTSize(size.width) * static_cast<double>(cv::getOptimalDFTSize(size.height));
+    const double correlation = padded * (4.0 * 2.0 * std::log2(padded) + 16.0);
+
+    return matching <= correlation;
+}
+
+//
+// Returns the shift, with subpixel precision, of 'gray' in the region of
+// AP 'point' moved by 'offset' relative to the reference, 'offset' included.
+//
+// 'response' is the NCC at the best displacement, 1 for identical content.
+// It is zero if the search area leaves 'gray', or if the best displacement
+// is on the edge of the search area, the actual one being likely beyond it.
+//
+cv::Point2f BlockMatcher::match(const cv::Mat &gray, int point, cv::Point offset, double *response) const {
+    if (response) {
+        *response = 0.0;
+    }
+
+    const cv::Rect &region = _regions[point];
+    cv::Rect area{region.x + offset.x - _radius, region.y + offset.y - _radius,
+                  region.width + 2 * _radius, region.height + 2 * _radius};
+    if (empty() || region.empty() || _norms[point] <= 0.0 || (area & cv::Rect(0, 0, gray.cols, gray.rows)) != area) {
+        return offset;
+    }
+
+    // Per-thread buffers, reused for every AP
+    thread_local cv::Mat target, sums, squareSums, scores;
+    gray(area).convertTo(target, CV_32F);
+    cv::integral(target, sums, squareSums, CV_64F, CV_64F);
+
+    const int side = 2 * _radius + 1;
+    const int width = _size.width, height = _size.height;
+    const double pixels = static_cast<double>(width) * height;
+    const cv::Mat reference = _patches.rowRange(point * height, (point + 1) * height);
+
+    scores.create(side, side, CV_64F);
+    for (int dy = 0; dy < side; ++dy) {
+        double *scoreRow = scores.ptr<double>(dy);
+        for (int dx = 0; dx < side; ++dx) {
+            // The reference has zero mean, so its products with the target
+            // need no centering of the target
+            double product = 0.0;
+            for (int y = 0; y < height; ++y) {
+                product += dot(reference.ptr<float>(y), target.ptr<float>(dy + y) + dx, width);
+            }
+
+            auto windowSum = [&](const cv::Mat &integral) {
+                return integral.at<double>(dy + height, dx + width) - integral.at<double>(dy, dx + width)
+                     - integral.at<double>(dy + height, dx) + integral.at<double>(dy, dx);
+            };
+            double sum = windowSum(sums);
+            double variance = windowSum(squareSums) - sum * sum / pixels;
+
+            scoreRow[dx] = variance > 0.0 ? product / (_norms[point] * std::sqrt(variance)) : 0.0;
+        }
+    }
+
+    double best = 0.0;
+    cv::Point peak;
+    cv::minMaxLoc(scores, nullptr, &best, nullptr, &peak);
+    if (peak.x == 0 || peak.y == 0 || peak.x == side - 1 || peak.y == side - 1) {
+        return offset;
+    }
+
+    if (response) {
+        *response = best;
+    }
+
+    const double *row = scores.ptr<double>(peak.y);
+    cv::Point2d refined{
+        peak.x + parabolicOffset(row[peak.x - 1], best, row[peak.x + 1]),
+        peak.y + parabolicOffset(scores.at<double>(peak.y - 1, peak.x), best, scores.at<double>(peak.y + 1, peak.x))
+    };
+
+    return cv::Point2f(
+        static_cast<float>(offset.x + refined.x - _radius),
+        static_cast<float>(offset.y + refined.y - _radius)
+    );
+}
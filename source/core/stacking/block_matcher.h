@@ -0,0 +1,35 @@
+#ifndef BLOCK_MATCHER_H
+#define BLOCK_MATCHER_H
+
+#include <opencv2/opencv.hpp>
+
+// Direct matching of small alignment points, an alternative to phase
+// correlation.
+//
+// Every displacement within a search radius is scored by the normalized
+// cross-correlation (NCC) of the reference patch and the frame, and the best
+// one refined to subpixel precision by a parabola through its neighbours.
+// For small APs and small residual shifts, as left by tracking, this takes
+// fewer operations than transforming the patch.
+class BlockMatcher {
+public:
+    BlockMatcher() = default;
+    BlockMatcher(const cv::Mat &gray, const std::vector<cv::Rect> &regions, int radius);
+
+    static bool preferred(cv::Size size, int radius);
+
+    bool empty() const { return _patches.empty(); }
+
+    cv::Point2f match(const cv::Mat &gray, int point, cv::Point offset, double *response = nullptr) const;
+
+private:
+    // Regions of the reference, empty for APs left out
+    std::vector<cv::Rect> _regions;
+    cv::Size _size;
+    int _radius = 0;
+    // Zero mean reference patches, stacked vertically, and their norms
+    cv::Mat _patches;
+    std::vector<double> _norms;
+};
+
+#endif // BLOCK_MATCHER_H
@@ -0,0 +1,123 @@
+#include "phase_correlator.h"
+
+//
+// Prepares correlations against 'region' of 'reference'.
+//
+PhaseCorrelator::PhaseCorrelator(const cv::Mat &reference, cv::Rect region)
+    : _region(region & cv::Rect(0, 0, reference.cols, reference.rows))
+{
+    // The window needs at least two pixels per side
+    if (_region.width < 2 || _region.height < 2) {
+        _region = {};
+        return;
+    }
+
+    cv::createHanningWindow(_window, _region.size(), CV_32F);
+    _padded = {cv::getOptimalDFTSize(_region.width), cv::getOptimalDFTSize(_region.height)};
+    _spectrum = _transform(reference(_region));
+}
+
+//
+// Returns the windowed, zero-padded spectrum of 'patch', of the region's size.
+//
+cv::Mat PhaseCorrelator::_transform(const cv::Mat &patch) const {
+    cv::Mat gray;
+    if (patch.channels() > 1) {
+        cv::cvtColor(patch, gray, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        gray = patch;
+    }
+
+    cv::Mat windowed;
+    gray.convertTo(windowed, CV_32F);
+    windowed = windowed.mul(_window);
+
+    cv::Mat padded;
+    cv::copyMakeBorder(windowed, padded, 0, _padded.height - windowed.rows, 0, _padded.width - windowed.cols, cv::BORDER_CONSTANT);
+
+    cv::Mat spectrum;
+    cv::dft(padded, spectrum, cv::DFT_COMPLEX_OUTPUT);
+    return spectrum;
+}
+
+//
+// Returns the shift, with subpixel precision, of 'frame' in the region moved
+// by 'offset' relative to the reference region, 'offset' included.
+//
+// 'response' is the height of the correlation peak, 1 for identical content.
+// If the moved region leaves 'frame', the shift is 'offset' and the response 0.
+//
+cv::Point2f PhaseCorrelator::shift(const cv::Mat &frame, cv::Point offset, double *response) const {
+    cv::Rect moved = _region + offset;
+    if (empty() || (moved & cv::Rect(0, 0, frame.cols, frame.rows)) != moved) {
+        if (response) {
+            *response = 0.0;
+        }
+        return offset;
+    }
+
+    cv::Mat crossPower;
+    crossPowerSpectrum(_spectrum, _transform(frame(moved)), crossPower);
+
+    cv::Mat correlation;
+    cv::idft(crossPower, correlation, cv::DFT_REAL_OUTPUT);
+
+    return cv::Point2f(offset) + peakShift(correlation, response);
+}
+
+//
+// Computes the normalized cross-power spectrum of 'reference' and 'target',
+// complex spectra (or batches of them) of the same size, into 'crossPower'.
+//
+void PhaseCorrelator::crossPowerSpectrum(const cv::Mat &reference, const cv::Mat &target, cv::Mat &crossPower) {
+    cv::mulSpectrums(reference, target, crossPower, 0, true);
+    for (int y = 0; y < crossPower.rows; ++y) {
+        auto *row = crossPower.ptr<cv::Vec2f>(y);
+        for (int x = 0; x < crossPower.cols; ++x) {
+            float magnitude = std::sqrt(row[x][0] * row[x][0] + row[x][1] * row[x][1]);
+            row[x] *= 1.0f / (magnitude + FLT_EPSILON);
+        }
+    }
+}
+
+//
+// Returns the shift found by the peak of 'correlation', the inverse transform
+// of a normalized cross-power spectrum, with subpixel precision (weighted
+// centroid of its 5x5 neighbourhood). The height of the peak, 1 for
+// identical content, is written to 'response'.
+//
+cv::Point2f PhaseCorrelator::peakShift(const cv::Mat &correlation, double *response) {
+    cv::Point peak;
+    cv::minMaxLoc(correlation, nullptr, nullptr, nullptr, &peak);
+
+    // Weighted centroid of the 5x5 neighbourhood of the peak, which wraps around
+    const int width = correlation.cols, height = correlation.rows;
+    double sum = 0.0, xSum = 0.0, ySum = 0.0;
+    for (int dy = -2; dy <= 2; ++dy) {
+        const float *row = correlation.ptr<float>((peak.y + dy + height) % height);
+        for (int dx = -2; dx <= 2; ++dx) {
+            float value = row[(peak.x + dx + width) % width];
+            sum += value;
+            xSum += value * (peak.x + dx);
+            ySum += value * (peak.y + dy);
+        }
+    }
+
+    if (response) {
+        // A perfect match sums to the number of samples
+        *response = sum / (static_cast<double>(width) * height);
+    }
+
+    cv::Point2d centroid = sum != 0.0 ? cv::Point2d(xSum / sum, ySum / sum) : cv::Point2d(peak);
+
+    // The peak is at minus the shift, modulo the transform size
+    auto unwrap = [](double position, int size) {
+        return position >= size / 2.0 ? position - size : position;
+    };
+
+    return cv::Point2f(
+        static_cast<float>(-unwrap(centroid.x, width)),
+        static_cast<float>(-unwrap(centroid.y, height))
+    );
+}
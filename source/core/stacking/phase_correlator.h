@@ -0,0 +1,34 @@
+#ifndef PHASE_CORRELATOR_H
+#define PHASE_CORRELATOR_H
+
+#include <opencv2/opencv.hpp>
+
+// Phase correlation against a fixed region of a reference frame.
+//
+// The reference region is converted, windowed (Hanning) and transformed
+// once, at construction, zero-padded to a size the DFT is fast for. Every
+// correlation then only transforms the target, applies the window once,
+// and inverts the normalized cross-power spectrum.
+class PhaseCorrelator {
+public:
+    PhaseCorrelator() = default;
+    PhaseCorrelator(const cv::Mat &reference, cv::Rect region);
+
+    bool empty() const { return _spectrum.empty(); }
+    cv::Rect region() const { return _region; }
+
+    cv::Point2f shift(const cv::Mat &frame, cv::Point offset = {0, 0}, double *response = nullptr) const;
+
+    static void crossPowerSpectrum(const cv::Mat &reference, const cv::Mat &target, cv::Mat &crossPower);
+    static cv::Point2f peakShift(const cv::Mat &correlation, double *response = nullptr);
+
+private:
+    cv::Rect _region;
+    cv::Mat _window;
+    cv::Size _padded;
+    cv::Mat _spectrum;
+
+    cv::Mat _transform(const cv::Mat &patch) const;
+};
+
+#endif // PHASE_CORRELATOR_H
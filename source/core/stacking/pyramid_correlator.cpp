@@ -0,0 +1,136 @@
+#include "pyramid_correlator.h"
+
+// Side of the full resolution window, a fast transform size
+constexpr int fineSize = 256;
+// Least distance of the window to the border, room for the jitter of frames
+constexpr int fineMargin = 32;
+
+//
+// Returns 'frame' as a single channel, reduced 'levels' times
+// by a Gaussian pyramid.
+//
+static cv::Mat reduced(const cv::Mat &frame, int levels) {
+    cv::Mat result;
+    if (frame.channels() > 1) {
+        cv::cvtColor(frame, result, cv::COLOR_BGR2GRAY);
+    }
+    else {
+        result = frame;
+    }
+
+    for (int i = 0; i < levels; ++i) {
+        cv::pyrDown(result, result);
+    }
+    return result;
+}
+
+//
+// Returns the 'size' x 'size' region of 'coarse' with the highest mean
+// gradient magnitude, searched in half size steps within 'area'.
+//
+static cv::Rect detailedRegion(const cv::Mat &coarse, int size, cv::Rect area) {
+    cv::Mat gradX, gradY, magnitude;
+    cv::Sobel(coarse, gradX, CV_32F, 1, 0, 3);
+    cv::Sobel(coarse, gradY, CV_32F, 0, 1, 3);
+    magnitude = cv::abs(gradX) + cv::abs(gradY);
+
+    cv::Mat sums;
+    cv::integral(magnitude, sums, CV_64F);
+
+    const int step = std::max(1, size / 2);
+    cv::Rect best{area.x, area.y, size, size};
+    double bestSum = -1.0;
+    for (int y = area.y; y + size <= area.br().y; y += step) {
+        for (int x = area.x; x + size <= area.br().x; x += step) {
+            double sum = sums.at<double>(y + size, x + size) - sums.at<double>(y, x + size)
+                       - sums.at<double>(y + size, x) + sums.at<double>(y, x);
+            if (sum > bestSum) {
+                bestSum = sum;
+                best = {x, y, size, size};
+            }
+        }
+    }
+    return best;
+}
+
+//
+// Prepares coarse-to-fine correlations against 'reference', reduced
+// 'levels' times at the top of the pyramid.
+//
+PyramidCorrelator::PyramidCorrelator(const cv::Mat &reference, int levels) : _levels(levels) {
+    _whole = PhaseCorrelator(reference, {0, 0, reference.cols, reference.rows});
+    if (_levels <= 0 || std::min(reference.cols, reference.rows) < (fineSize << 1)) {
+        _levels = 0;
+        return;
+    }
+
+    cv::Mat coarse = reduced(reference, _levels);
+    _coarse = PhaseCorrelator(coarse, {0, 0, coarse.cols, coarse.rows});
+
+    // The window is placed on the coarse level, where finding it is cheap,
+    // away from the border
+    const int margin = (fineMargin + (1 << _levels) - 1) >> _levels;
+    cv::Rect area(margin, margin, coarse.cols - 2 * margin, coarse.rows - 2 * margin);
+    cv::Rect region = detailedRegion(coarse, fineSize >> _levels, area);
+    cv::Rect fine{
+        std::clamp(region.x << _levels, fineMargin, reference.cols - fineSize - fineMargin),
+        std::clamp(region.y << _levels, fineMargin, reference.rows - fineSize - fineMargin),
+        fineSize,
+        fineSize
+    };
+    _fine = PhaseCorrelator(reference, fine);
+}
+
+//
+// Returns the number of pyramid levels worth using for frames of 'size':
+// as many as keep the top level at least 128 pixels on its short side, up
+// to 3 (1/8 scale). Below 2 levels, the two correlations cost about as much
+// as a single one at full resolution, and 0 is returned.
+//
+int PyramidCorrelator::levelsFor(cv::Size size) {
+    constexpr int minSide = 128;
+    constexpr int maxLevels = 3;
+
+    int levels = 0;
+    while (levels < maxLevels && (std::min(size.width, size.height) >> (levels + 1)) >= minSide) {
+        ++levels;
+    }
+    return levels >= 2 ? levels : 0;
+}
+
+//
+// Returns the shift, with subpixel precision, of 'frame' relative to the
+// reference. 'response' is the height of the full resolution correlation
+// peak, 1 for identical content.
+//
+// If the coarse or the fine correlation peaks below 'confidence', the whole
+// frame is correlated at full resolution instead.
+//
+cv::Point2f PyramidCorrelator::shift(const cv::Mat &frame, double confidence, double *response) const {
+    if (_levels > 0 && frame.size() == _whole.region().size()) {
+        double coarseResponse = 0.0;
+        cv::Point2f estimate = _coarse.shift(reduced(frame, _levels), {0, 0}, &coarseResponse) * static_cast<float>(1 << _levels);
+
+        if (coarseResponse >= confidence) {
+            // The estimate is off by a few pixels at most, well within the window.
+            // Large shifts are clamped to keep the window inside the frame,
+            // leaving the rest to the window's own correlation.
+            const cv::Rect fine = _fine.region();
+            cv::Point offset{
+                std::clamp(cvRound(estimate.x), -fine.x, frame.cols - fine.br().x),
+                std::clamp(cvRound(estimate.y), -fine.y, frame.rows - fine.br().y)
+            };
+
+            double fineResponse = 0.0;
+            cv::Point2f shift = _fine.shift(frame, offset, &fineResponse);
+            if (fineResponse >= confidence) {
+                if (response) {
+                    *response = fineResponse;
+                }
+                return shift;
+            }
+        }
+    }
+
+    return _whole.shift(frame, {0, 0}, response);
+}
@@ -0,0 +1,35 @@
+#ifndef PYRAMID_CORRELATOR_H
+#define PYRAMID_CORRELATOR_H
+
+#include "stacking/phase_correlator.h"
+
+// Coarse-to-fine phase correlation of whole frames against a reference.
+//
+// Frames are reduced by a Gaussian pyramid and correlated whole at the top
+// level, which finds the shift to a few pixels with a transform 16 to 64
+// times smaller. A window of the reference, where it has the most detail,
+// is then correlated at full resolution around that estimate, restoring
+// subpixel precision. Frames that either step isn't confident about are
+// correlated whole at full resolution, as they are with no levels.
+class PyramidCorrelator {
+public:
+    PyramidCorrelator() = default;
+    PyramidCorrelator(const cv::Mat &reference, int levels);
+
+    static int levelsFor(cv::Size size);
+
+    bool empty() const { return _whole.empty(); }
+    int levels() const { return _levels; }
+
+    cv::Point2f shift(const cv::Mat &frame, double confidence, double *response = nullptr) const;
+
+private:
+    int _levels = 0;
+    // Top of the reference's pyramid, full resolution window, and whole
+    // reference at full resolution (the fallback)
+    PhaseCorrelator _coarse;
+    PhaseCorrelator _fine;
+    PhaseCorrelator _whole;
+};
+
+#endif // PYRAMID_CORRELATOR_H
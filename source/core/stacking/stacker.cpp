@@ -1,5 +1,7 @@
 #include "stacker.h"
 #include "components/frame.h"
+#include "stacking/tracker.h"
+#include <atomic>
 
 void Stacker::initialize(const cv::Mat reference, const _StackConfig &config) {
     _reset();
@@ -9,24 +11,75 @@ void Stacker::initialize(const cv::Mat reference, const _StackConfig &config) {
 
     _config = config;
 
+    static std::atomic<int> generations = 0;
+    _generation = ++generations;
+
+    // Tracking window: the object, with a margin for the jitter left after
+    // prediction, sized for a fast transform. Worth it only if it is much
+    // smaller than the frame.
+    Frame::ObjectLocation location = Frame::locateObject(_reference);
+    if (location.found) {
+        constexpr int margin = 32;
+        cv::Rect window{
+            location.bounds.x - margin,
+            location.bounds.y - margin,
+            cv::getOptimalDFTSize(location.bounds.width + 2 * margin),
+            cv::getOptimalDFTSize(location.bounds.height + 2 * margin)
+        };
+        window &= cv::Rect(0, 0, _reference.cols, _reference.rows);
+        if (2 * window.area() <= _reference.cols * _reference.rows) {
+            _windowCorrelator = PhaseCorrelator(_reference, window);
+        }
+    }
+
+    // Reference spectra are computed once here, frames are only correlated against them
+    int levels = _config.globalAlignment == GlobalAlignment::Pyramid ? PyramidCorrelator::levelsFor(_reference.size()) : 0;
+    _globalCorrelator = PyramidCorrelator(_reference, levels);
+    if (_config.aps) {
+        std::vector<cv::Rect> regions;
+        for (const auto &ap : *_config.aps) {
+            regions.push_back(ap.rect());
+        }
+        // Tracking leaves residual AP shifts of a few pixels, which block matching searches
+        constexpr int searchRadius = 4;
+        _apCorrelator = ApCorrelator(_reference, regions, _config.localAlignment, searchRadius);
+    }
+
     // Initialize internal accumulators
     cv::Size upsampledSize{
         static_cast<int>(_reference.cols * _config.upsample),
         static_cast<int>(_reference.rows * _config.upsample)
     };
-    _localAccumulator = cv::Mat::zeros(upsampledSize, CV_32FC3);
+    _localAccumulator = cv::Mat::zeros(upsampledSize, CV_32FC(_reference.channels()));
     _localWeights = cv::Mat::zeros(upsampledSize, CV_32F);
     _globalAccumulator = _localAccumulator.clone();
     _globalWeights = _localWeights.clone();
 
     // Include reference frame
-    _globalAccumulator += _reference * 1.0f;
+    cv::Mat reference32F;
+    _reference.convertTo(reference32F, CV_32F, Frame::to8BitScale(_reference.depth()));
+    cv::resize(reference32F, reference32F, upsampledSize, 0, 0, cv::INTER_LANCZOS4);
+    _globalAccumulator += reference32F;
     _globalWeights += 1.0f;
 }
 
-void Stacker::add(cv::Mat mat, double weight) {
+void Stacker::add(cv::Mat mat, double weight, Bayer::Pattern pattern, int scale) {
+    // Raw frames are debayered into a per-thread buffer, reused for every frame
+    thread_local cv::Mat color;
+    mat = Bayer::debayer(mat, pattern, _config.debayer, color);
+
+    // Each worker follows the frames it is given, which come in file order
+    thread_local struct {
+        int generation = 0;
+        Tracker tracker;
+    } tracking;
+    if (tracking.generation != _generation) {
+        tracking.generation = _generation;
+        tracking.tracker = Tracker(_config.aps ? _config.aps->size() : 0);
+    }
+
     // Compute global shift relative to reference
-    cv::Point2f globalShift = computeShift(_reference, mat, 0.35);
+    cv::Point2f globalShift = tracking.tracker.trackGlobal(mat, _globalCorrelator, _windowCorrelator, 0.35);
     cv::Mat globalM = (cv::Mat_<double>(2, 3) <<
         1, 0, -globalShift.x,
         0, 1, -globalShift.y
@@ -34,10 +87,11 @@ void Stacker::add(cv::Mat mat, double weight) {
 
     cv::Size upsampledSize = _globalAccumulator.size();
 
-    // Apply global alignment
+    // Apply global alignment. Phase correlation doesn't depend on the range
+    // of the samples, 'scale' is only needed from here on.
     cv::Mat globalAligned;
     cv::warpAffine(mat, globalAligned, globalM, _reference.size(), cv::INTER_LANCZOS4);
-    globalAligned.convertTo(globalAligned, CV_32FC3);
+    globalAligned.convertTo(globalAligned, CV_32F, Frame::to8BitScale(mat.depth()) * scale);
 
     // Upsample the globally aligned frame
     cv::Mat globalAlignedUpsampled;
@@ -54,7 +108,17 @@ void Stacker::add(cv::Mat mat, double weight) {
         // Padding to exclude borders interpolation (e.g. BORDER_REPLICATE)
         constexpr int padding = 5;
 
-        for (const auto &ap : *_config.aps) {
+        // Local shifts between the APs in reference and globally aligned frame
+        thread_local std::vector<cv::Point2f> localShifts;
+        tracking.tracker.trackLocal(globalAligned, _apCorrelator, 0.85, localShifts);
+
+        for (int i = 0; i < _config.aps->size(); ++i) {
+            // APs crossing the border have no local shift, global alignment covers them
+            if (!_apCorrelator.covers(i)) {
+                continue;
+            }
+
+            const AlignmentPoint &ap = *(_config.aps->begin() + i);
             // Original AP's ROI
             cv::Rect roi = ap.rect(), paddedRoi = roi;
             roi &= cv::Rect(0, 0, _reference.cols, _reference.rows);
@@ -72,8 +136,7 @@ void Stacker::add(cv::Mat mat, double weight) {
             int padX[2] {roi.x - paddedRoi.x, paddedRoi.x + paddedRoi.width - roi.x - roi.width};
             int padY[2] {roi.y - paddedRoi.y, paddedRoi.y + paddedRoi.height - roi.y - roi.height};
 
-            // Local shift between the ROI in reference and globally aligned frame
-            cv::Point2f localShift = computeShift(_reference(roi), globalAligned(roi));
+            const cv::Point2f &localShift = localShifts[i];
             cv::Mat localM = (cv::Mat_<double>(2, 3) <<
                 1, 0, -localShift.x * _config.upsample,
                 0, 1, -localShift.y * _config.upsample
@@ -114,30 +177,33 @@ void Stacker::add(cv::Mat mat, double weight) {
 }
 
 cv::Mat Stacker::average() {
+    const int channels = _globalAccumulator.channels();
+
     // Final result mat
-    cv::Mat result(_globalAccumulator.size(), CV_32FC3);
+    cv::Mat result(_globalAccumulator.size(), _globalAccumulator.type());
 
     // Combine local and global accumulations
     if (_config.aps) {
         for (int y = 0; y < result.rows; ++y) {
+            const float *localW = _localWeights.ptr<float>(y);
+            const float *globalW = _globalWeights.ptr<float>(y);
+            const float *local = _localAccumulator.ptr<float>(y);
+            const float *global = _globalAccumulator.ptr<float>(y);
+            float *out = result.ptr<float>(y);
             for (int x = 0; x < result.cols; ++x) {
-                float localW = _localWeights.at<float>(y, x);
-                if (localW > 0.0f) {
-                    result.at<cv::Vec3f>(y, x) = _localAccumulator.at<cv::Vec3f>(y, x) / localW;
-                }
-                else {
-                    float globalW = _globalWeights.at<float>(y, x);
-                    result.at<cv::Vec3f>(y, x) = _globalAccumulator.at<cv::Vec3f>(y, x) / globalW;
+                for (int c = 0; c < channels; ++c) {
+                    int i = x * channels + c;
+                    out[i] = localW[x] > 0.0f ? local[i] / localW[x] : global[i] / globalW[x];
                 }
             }
         }
     }
     // Normalize global accumulation only
     else {
-        cv::Mat weights3;
-        cv::Mat weightsChannels[] {_globalWeights, _globalWeights, _globalWeights};
-        cv::merge(weightsChannels, 3, weights3);
-        cv::divide(_globalAccumulator, weights3, result);
+        cv::Mat weights;
+        std::vector<cv::Mat> weightsChannels(channels, _globalWeights);
+        cv::merge(weightsChannels, weights);
+        cv::divide(_globalAccumulator, weights, result);
     }
 
     // Expand borders (padding with black)
@@ -152,6 +218,9 @@ cv::Mat Stacker::average() {
 
 void Stacker::_reset() {
     _reference.release();
+    _globalCorrelator = {};
+    _windowCorrelator = {};
+    _apCorrelator = {};
     _globalAccumulator.release();
     _globalWeights.release();
     _localAccumulator.release();
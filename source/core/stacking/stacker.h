@@ -3,6 +3,9 @@
 
 #include <opencv2/opencv.hpp>
 #include "stacking/alignment.h"
+#include "stacking/ap_correlator.h"
+#include "stacking/pyramid_correlator.h"
+#include "components/bayer.h"
 
 struct StackConfig {
     // Sorted frames as index-quality pair
@@ -22,18 +25,29 @@ struct _StackConfig {
     int outputHeight;
     AlignmentPointSet *aps = nullptr;
     double upsample = 1.0;
+    Bayer::Method debayer = Bayer::Method::EdgeAware;
+    GlobalAlignment globalAlignment = GlobalAlignment::Pyramid;
+    LocalAlignment localAlignment = LocalAlignment::Automatic;
 };
 
 class Stacker{
 public:
     void initialize(const cv::Mat reference, const _StackConfig &config);
-    void add(cv::Mat mat, double weight);
+    void add(cv::Mat mat, double weight, Bayer::Pattern pattern = Bayer::Pattern::None, int scale = 1);
     cv::Mat average();
 
 private:
     cv::Mat _reference;
     _StackConfig _config;
 
+    // Whole reference, its object and margin (correlated by trackers instead
+    // of whole frames), and all APs, correlated in one batch
+    PyramidCorrelator _globalCorrelator;
+    PhaseCorrelator _windowCorrelator;
+    ApCorrelator _apCorrelator;
+    // Tells per-thread trackers apart from those of a previous stack
+    int _generation = 0;
+
     cv::Mat _localAccumulator, _localWeights;
     cv::Mat _globalAccumulator, _globalWeights;
 
@@ -0,0 +1,109 @@
+#include "tracker.h"
+
+//
+// Correlates 'frame' with 'correlator' at the region moved by 'prediction'.
+// Returns false if there is no prediction or the correlation isn't confident.
+//
+static bool predictedShift(const cv::Mat &frame, const PhaseCorrelator &correlator,
+                           const std::optional<cv::Point2f> &prediction, double confidence, cv::Point2f &shift) {
+    if (!prediction || correlator.empty()) {
+        return false;
+    }
+
+    double response = 0.0;
+    shift = correlator.shift(frame, {cvRound(prediction->x), cvRound(prediction->y)}, &response);
+    return response >= confidence;
+}
+
+//
+// Correlates the whole 'frame' with 'correlator'. The shift is zero,
+// and 'last' forgotten, if the correlation isn't confident.
+//
+static cv::Point2f searchedShift(const cv::Mat &frame, const PyramidCorrelator &correlator,
+                                 double confidence, std::optional<cv::Point2f> &last) {
+    double response = 0.0;
+    cv::Point2f shift = correlator.shift(frame, confidence, &response);
+    if (response < confidence) {
+        last.reset();
+        return {0.0f, 0.0f};
+    }
+
+    last = shift;
+    return shift;
+}
+
+Tracker::Tracker(int points) : _local(points) {}
+
+//
+// Returns the global shift of 'frame' relative to the reference.
+//
+// With a prediction, only the 'window' correlator's region (the object and
+// a margin) is correlated, a much smaller transform than the 'whole' frame.
+// An empty 'window' always correlates whole frames, coarse to fine
+// if 'whole' has pyramid levels.
+//
+cv::Point2f Tracker::trackGlobal(const cv::Mat &frame, const PyramidCorrelator &whole, const PhaseCorrelator &window, double confidence) {
+    cv::Point2f shift;
+    if (predictedShift(frame, window, _global, confidence, shift)) {
+        _global = shift;
+        return shift;
+    }
+
+    // Re-acquire over the whole frame
+    return searchedShift(frame, whole, confidence, _global);
+}
+
+//
+// Writes the local shift of every alignment point of 'aps', in the globally
+// 'aligned' frame, to 'shifts'.
+//
+// The last shift of each point is where its correlation starts, so
+// displacements larger than the AP's correlation can reliably find
+// are still followed. All points are correlated in one batch, then the
+// ones that moved and lost confidence are searched again, in a second one.
+//
+void Tracker::trackLocal(const cv::Mat &aligned, const ApCorrelator &aps, double confidence, std::vector<cv::Point2f> &shifts) {
+    thread_local std::vector<int> batch, retried;
+    thread_local std::vector<cv::Point> offsets;
+    thread_local std::vector<ApCorrelator::Result> results;
+
+    shifts.assign(_local.size(), {0.0f, 0.0f});
+
+    batch.clear();
+    offsets.clear();
+    for (int i = 0; i < points(); ++i) {
+        batch.push_back(i);
+        offsets.push_back(_local[i] ? cv::Point(cvRound(_local[i]->x), cvRound(_local[i]->y)) : cv::Point(0, 0));
+    }
+    aps.correlate(aligned, batch, offsets, confidence, results);
+
+    retried.clear();
+    for (int i = 0; i < batch.size(); ++i) {
+        if (results[i].response >= confidence) {
+            _local[i] = shifts[i] = results[i].shift;
+        }
+        else if (offsets[i] != cv::Point(0, 0)) {
+            retried.push_back(i);
+        }
+        else {
+            _local[i].reset();
+        }
+    }
+
+    if (retried.empty()) {
+        return;
+    }
+
+    // Re-acquire around the APs themselves
+    offsets.assign(retried.size(), {0, 0});
+    aps.correlate(aligned, retried, offsets, confidence, results);
+    for (int i = 0; i < retried.size(); ++i) {
+        auto &last = _local[retried[i]];
+        if (results[i].response >= confidence) {
+            last = shifts[retried[i]] = results[i].shift;
+        }
+        else {
+            last.reset();
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include "stacking/ap_correlator.h"
+#include "stacking/pyramid_correlator.h"
+
+// Carries the global and alignment point shifts of a frame over to the next.
+//
+// Consecutive frames differ by a few pixels of seeing jitter, so the last
+// shifts predict the next ones. A window moved by the prediction is
+// correlated first, which leaves a small residual to find, and the whole
+// frame (or AP) is searched again only when that correlation isn't confident.
+class Tracker {
+public:
+    explicit Tracker(int points = 0);
+
+    int points() const { return static_cast<int>(_local.size()); }
+
+    cv::Point2f trackGlobal(const cv::Mat &frame, const PyramidCorrelator &whole, const PhaseCorrelator &window, double confidence);
+    void trackLocal(const cv::Mat &aligned, const ApCorrelator &aps, double confidence, std::vector<cv::Point2f> &shifts);
+
+private:
+    // Last confident shifts, if any
+    std::optional<cv::Point2f> _global;
+    std::vector<std::optional<cv::Point2f>> _local;
+};
+
+#endif // TRACKER_H
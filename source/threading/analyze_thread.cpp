@@ -1,60 +1,269 @@
 #include "analyze_thread.h"
+#include "data/frame_stream.h"
+#include "data/analysis_cache.h"
 #include "components/frame.h"
 #include "asio/thread_pool.hpp"
 #include "asio/post.hpp"
-#include <QDebug>
+#include <limits>
+#include <numeric>
 
 AnalyzeThread::AnalyzeThread(
     MediaCollection &files,
-    std::vector<std::pair<int, double>> &output,
+    QualityMetrics &metrics,
+    std::vector<std::vector<double>> &scores,
+    AnalyzeConfig &config,
     QObject *parent)
-: Thread(parent), _files(files), _output(output) {}
+: Thread(parent), _files(files), _metrics(metrics), _scores(scores), _config(config) {}
 
 void AnalyzeThread::run() {
+    // Every selected metric is scored from the same decoded frame.
+    // Frames that aren't scored yet are NaN.
+    const int totalFrames = _files.totalFrames();
+    _scores.assign(_metrics.selected().size(), std::vector<double>(totalFrames, std::numeric_limits<double>::quiet_NaN()));
+
+    // Sized on the first frame of the collection, for every file alike,
+    // so that scores of cached and newly analyzed files compare
+    _window = {};
+    if (_config.objectRegion && totalFrames > 0) {
+        _findObject();
+    }
+
+    // Files analyzed before with the same settings are loaded, the others scored
+    std::vector<int> frames;
+    std::vector<int> analyzedFiles;
+    for (int i = 0; i < _files.fileCount(); ++i) {
+        if (!_loadCache(i)) {
+            analyzedFiles.push_back(i);
+            for (int frame = 0; frame < _files[i].frames(); ++frame) {
+                frames.push_back(_files.fileOffset(i) + frame);
+            }
+        }
+    }
+
+    // Progress counter, cached frames are done already
+    std::atomic<int> counter = totalFrames - static_cast<int>(frames.size());
+    emit progressUpdated(counter);
+
+    if (_config.progressive) {
+        _analyzeProgressively(frames, counter);
+    }
+    else {
+        _score(frames, counter);
+    }
+
+    // Stopped early, the last provisional ranking stays in use
+    if (!running) {
+        return;
+    }
+
+    for (int file : analyzedFiles) {
+        _saveCache(file);
+    }
+
+    emit finished();
+    running = false;
+}
+
+//
+// Fills the scores of 'file' from its cache, returns false
+// if any of the selected metrics isn't cached with the current settings.
+//
+bool AnalyzeThread::_loadCache(int file) {
+    const MediaFile &media = _files[file];
+    AnalysisCache cache = AnalysisCache::open(QString::fromStdString(media.path()), media.frames(), QSize(_window.width, _window.height));
+
+    const auto &selected = _metrics.selected();
+    bool complete = std::all_of(selected.begin(), selected.end(), [&cache](int metric) {
+        return cache.hasScores(metric);
+    });
+    if (!complete) {
+        return false;
+    }
+
+    const int offset = _files.fileOffset(file);
+    for (int i = 0; i < selected.size(); ++i) {
+        const auto &scores = cache.scores(selected[i]);
+        std::copy(scores.begin(), scores.end(), _scores[i].begin() + offset);
+    }
+
+    return true;
+}
+
+//
+// Saves the scores of 'file', keeping cached scores
+// of metrics that weren't selected this time.
+//
+void AnalyzeThread::_saveCache(int file) {
+    const MediaFile &media = _files[file];
+    AnalysisCache cache = AnalysisCache::open(QString::fromStdString(media.path()), media.frames(), QSize(_window.width, _window.height));
+
+    const int offset = _files.fileOffset(file);
+    const auto &selected = _metrics.selected();
+    for (int i = 0; i < selected.size(); ++i) {
+        auto begin = _scores[i].begin() + offset;
+        cache.setScores(selected[i], std::vector<float>(begin, begin + media.frames()));
+    }
+
+    cache.save();
+}
+
+//
+// Sizes the object window on the first frame: the object's bounding box,
+// padded for the jitter of the following frames. Leaves the window empty
+// (whole frames are scored) if no object stands out of the background.
+//
+void AnalyzeThread::_findObject() {
+    FrameStream stream(_files, {0}, 1, ReadMode::Luma);
+    FrameStream::Item item;
+    if (!stream.next(item)) {
+        return;
+    }
+
+    Frame::ObjectLocation location = Frame::locateObject(item.mat);
+    _threshold = location.threshold;
+    if (location.found) {
+        const cv::Rect &box = location.bounds;
+        const int padding = std::max(16, std::max(box.width, box.height) / 8);
+        _window = cv::Rect(box.x - padding, box.y - padding, box.width + 2 * padding, box.height + 2 * padding);
+        _window &= cv::Rect(0, 0, item.mat.cols, item.mat.rows);
+    }
+
+    stream.recycle(item);
+}
+
+//
+// Returns the part of 'luma' to score: the object window centered on the
+// object's centroid, shifted inside the frame so that its size, and so
+// the scores, stay comparable between frames.
+//
+// Frames where the object can't be found (e.g. clouds) keep the window
+// where it was on the first frame.
+//
+cv::Mat AnalyzeThread::_objectRegion(const cv::Mat &luma) {
+    if (_window.empty() || _window.width > luma.cols || _window.height > luma.rows) {
+        return luma;
+    }
+
+    cv::Rect window = _window;
+    cv::Point2f centroid = Frame::objectCentroid(luma, _threshold);
+    if (centroid.x >= 0.0f) {
+        window.x = std::clamp(cvRound(centroid.x) - window.width / 2, 0, luma.cols - window.width);
+        window.y = std::clamp(cvRound(centroid.y) - window.height / 2, 0, luma.rows - window.height);
+    }
+
+    return luma(window);
+}
+
+//
+// Scores 'frames' with all workers, returns when they are done
+// or the thread was stopped.
+//
+// Frames are decoded in order by the stream and scored by the pool.
+// Sharpness only needs luminance, color data never reaches the workers.
+//
+void AnalyzeThread::_score(const std::vector<int> &frames, std::atomic<int> &counter) {
+    if (frames.empty()) {
+        return;
+    }
+
     // Save one thread for the GUI, and one for the outer thread
-    asio::thread_pool pool(std::thread::hardware_concurrency() - 2);
+    const int workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);
+    asio::thread_pool pool(workers);
 
-    // Progress counter
-    auto counter = std::make_shared<std::atomic<int>>(0);
+    FrameStream stream(_files, frames, 2 * workers, ReadMode::Luma);
 
-    for (int i = 0; i < _files.totalFrames(); ++i) {
-        asio::post(pool, [this, counter, i]() {
-            cv::Mat frame = _files.matAtFrame(i);
-            _output[i].first = i;
-            _output[i].second = Frame::estimateQuality(frame);
-            emit progressUpdated(++(*counter));
+    for (int i = 0; i < workers; ++i) {
+        asio::post(pool, [this, &counter, &stream]() {
+            FrameStream::Item item;
+            std::vector<double> scores(_scores.size(), 0.0);
+            while (running && stream.next(item)) {
+                if (!item.mat.empty()) {
+                    // Luma of raw captures is their green plane, already at half resolution
+                    double scale = item.bayer != Bayer::Pattern::None ? 1.0 : 0.5;
+                    _metrics.evaluate(_objectRegion(item.mat), scale, scores);
+                    // Sharper frames are the ones stacking will ask for next
+                    _files.cacheFrame(item.frame, item.source, scores.front());
+                }
+                else {
+                    // Unreadable frames must never be picked
+                    std::fill(scores.begin(), scores.end(), 0.0);
+                }
+                for (int j = 0; j < scores.size(); ++j) {
+                    _scores[j][item.frame] = scores[j];
+                }
+                stream.recycle(item);
+                emit progressUpdated(++counter);
+            }
         });
     }
 
     // Wait until all frames are processed
     pool.join();
+}
 
-    // Normalize to [0, 1]
-    double minVal = std::numeric_limits<double>::max();
-    double maxVal = std::numeric_limits<double>::min();
-
-    for (const auto &pair : _output) {
-        minVal = std::min(minVal, pair.second);
-        maxVal = std::max(maxVal, pair.second);
-    }
+//
+// Scores every 16th of 'frames' first and publishes a provisional ranking,
+// where the other frames get scores interpolated from their neighbours.
+//
+// The gaps between samples are then filled best first, ordered by the
+// better of their two bounding samples, since seeing changes slowly and
+// good frames come in runs. The ranking is published again after every
+// eighth of the capture, so the top of it, which stacking uses, becomes
+// exact long before the last frames are scored.
+//
+void AnalyzeThread::_analyzeProgressively(const std::vector<int> &frames, std::atomic<int> &counter) {
+    constexpr int stride = 16;
+    constexpr int batches = 8;
+    const int count = static_cast<int>(frames.size());
 
-    double range = maxVal - minVal;
-    if (range > 0.0) {
-        for (auto &pair : _output) {
-            pair.second = (pair.second - minVal) / range;
+    auto publish = [this]() {
+        if (running) {
+            emit rankingUpdated(QualityMetrics::rank(QualityMetrics::interpolate(_scores.front())));
         }
+    };
+
+    // Positions in 'frames' of the samples
+    std::vector<int> samples;
+    std::vector<int> batch;
+    for (int i = 0; i < count; i += stride) {
+        samples.push_back(i);
+        batch.push_back(frames[i]);
     }
-    else {
-        for (auto &pair : _output) {
-            pair.second = 1.0;
+    _score(batch, counter);
+    publish();
+
+    // Gaps between consecutive samples, best first
+    const std::vector<double> &sampled = _scores.front();
+    auto priority = [&sampled, &frames, count](int sample) {
+        double score = sampled[frames[sample]];
+        if (sample + stride < count) {
+            score = std::max(score, sampled[frames[sample + stride]]);
         }
-    }
+        return score;
+    };
 
-    // Sort frames by quality (pair.second)
-    std::stable_sort(_output.begin(), _output.end(), [](const auto &a, const auto &b) {
-        return a.second > b.second;
+    std::vector<int> gaps(samples);
+    std::stable_sort(gaps.begin(), gaps.end(), [&priority](int a, int b) {
+        return priority(a) > priority(b);
     });
 
-    emit finished();
-    running = false;
+    const int batchSize = std::max(1, count / batches);
+    batch.clear();
+    for (int i = 0; i < gaps.size() && running; ++i) {
+        int end = std::min(gaps[i] + stride, count);
+        for (int position = gaps[i] + 1; position < end; ++position) {
+            batch.push_back(frames[position]);
+        }
+
+        if (batch.size() >= batchSize || i + 1 == gaps.size()) {
+            // In file order, for the decoders
+            std::sort(batch.begin(), batch.end());
+            _score(batch, counter);
+            batch.clear();
+
+            if (i + 1 < gaps.size()) {
+                publish();
+            }
+        }
+    }
 }
@@ -3,19 +3,38 @@
 
 #include "threading/thread.h"
 #include "data/media_collection.h"
+#include "components/quality_metrics.h"
 
+struct AnalyzeConfig {
+    // Score only a window around the object, rather than the whole frame
+    bool objectRegion = true;
+    // Score a sample of the frames first, and refine the ranking in passes
+    bool progressive = true;
+};
+
+// Quality analysis engine, used by every analysis entry point.
+//
+// A FrameStream decodes frames sequentially (one leased decoder per range)
+// into a bounded ring of buffers, a pool of workers scores them, and
+// 'QualityMetrics::rank()' reduces the scores to the ordered ranking.
+// Decoding waits for free buffers, so memory stays flat whatever the
+// length of the capture.
 class AnalyzeThread : public Thread {
     Q_OBJECT
 
 public:
     explicit AnalyzeThread(
         MediaCollection &files,
-        std::vector<std::pair<int, double>> &output,
+        QualityMetrics &metrics,
+        std::vector<std::vector<double>> &scores,
+        AnalyzeConfig &config,
         QObject *parent = nullptr
     );
 
 signals:
     void progressUpdated(int current);
+    // Provisional ranking, in progressive mode
+    void rankingUpdated(const std::vector<std::pair<int, double>> &ranking);
     void finished();
 
 protected:
@@ -23,7 +42,22 @@ protected:
 
 private:
     MediaCollection &_files;
-    std::vector<std::pair<int, double>> &_output;
+    QualityMetrics &_metrics;
+    // Raw score of every frame, per selected metric
+    std::vector<std::vector<double>> &_scores;
+    AnalyzeConfig &_config;
+
+    void _score(const std::vector<int> &frames, std::atomic<int> &counter);
+    void _analyzeProgressively(const std::vector<int> &frames, std::atomic<int> &counter);
+
+    bool _loadCache(int file);
+    void _saveCache(int file);
+
+    // Object window, sized on the first frame and moved to the object in every frame
+    cv::Rect _window;
+    double _threshold = 0.0;
+    void _findObject();
+    cv::Mat _objectRegion(const cv::Mat &luma);
 };
 
 #endif // ANALYZE_THREAD_H
@@ -1,17 +1,22 @@
 #include "threading/stack_thread.h"
+#include "data/frame_stream.h"
+#include "data/fits_file.h"
 #include "boost/asio/thread_pool.hpp"
 #include "boost/asio/post.hpp"
 #include <QDateTime>
+#include <numeric>
 
 _StackThread::_StackThread(
     MediaCollection &collection,
     _StackConfig &config,
     std::array<int, 4> &percentages,
-    std::vector<std::pair<int, double>> &frameQualities,
+    std::vector<double> &scores,
     std::string &outputDir,
+    OutputFormat &outputFormat,
     QObject *parent
 ) : Thread(parent), _collection(collection), _config(config),
-    _percentages(percentages), _frameQualities(frameQualities), _outputDir(outputDir)
+    _percentages(percentages), _scores(scores), _outputDir(outputDir),
+    _outputFormat(outputFormat)
 {}
 
 void _StackThread::run() {
@@ -23,29 +28,53 @@ void _StackThread::run() {
             continue;
         }
 
-        asio::thread_pool pool(std::thread::hardware_concurrency() - 2);
+        const int workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 2);
+        asio::thread_pool pool(workers);
 
         emit statusUpdated(QString("Stacking %1%...").arg(_percentages[i]));
 
         _stacker.initialize(_collection.matAtFrame(0), _config);
 
-        int framesToStack = static_cast<int>(_percentages[i] / 100.0 * _collection.totalFrames());
-        qDebug() << "framesToStack: " << framesToStack << "\n";
+        // Exactly the requested share of the best frames, ties going to the
+        // earlier frame as in the ranking, taken in frame order, which is also
+        // the fastest order to read them in. Weights are scores normalized to [0, 1].
+        const int total = static_cast<int>(_scores.size());
+        const int count = std::clamp(static_cast<int>(std::lround(total * _percentages[i] / 100.0)), 1, std::max(1, total));
+
+        std::vector<int> frames(total);
+        std::iota(frames.begin(), frames.end(), 0);
+        auto better = [this](int a, int b) {
+            return _scores[a] > _scores[b] || (_scores[a] == _scores[b] && a < b);
+        };
+        if (count < total) {
+            std::nth_element(frames.begin(), frames.begin() + count, frames.end(), better);
+            frames.resize(count);
+            std::sort(frames.begin(), frames.end());
+        }
+
+        auto [minIt, maxIt] = std::minmax_element(_scores.begin(), _scores.end());
+        const double minScore = total > 0 ? *minIt : 0.0;
+        const double range = total > 0 ? *maxIt - minScore : 0.0;
 
-        // Extract the necessary part of frames and sort them by their index.
-        // This is needed because consequent access to frames is much faster than random one.
-        std::vector<std::pair<int, double>> currentStack{_frameQualities.begin(), _frameQualities.begin() + framesToStack};
-        std::sort(currentStack.begin(), currentStack.end(), [](const auto &a, const auto &b) {
-            return a.first < b.first;
-        });
+        std::vector<double> weights(total);
+        for (int frame : frames) {
+            weights[frame] = range > 0.0 ? (_scores[frame] - minScore) / range : 1.0;
+        }
 
         auto counter = std::make_shared<std::atomic<int>>(0);
 
-        for (const auto &[index, quality] : currentStack) {
-            asio::post(pool, [this, index, quality, counter] {
-                qDebug() << "Adding " << index << "\n";
-                _stacker.add(_collection.matAtFrame(index), quality);
-                emit frameProcessed(QString::number(++(*counter)) + "/" + QString::number(_collection.totalFrames()));
+        FrameStream stream(_collection, frames, 2 * workers);
+
+        for (int j = 0; j < workers; ++j) {
+            asio::post(pool, [this, counter, &stream, &weights] {
+                FrameStream::Item item;
+                while (stream.next(item)) {
+                    if (!item.mat.empty()) {
+                        _stacker.add(item.mat, weights[item.frame], item.bayer, item.scale);
+                    }
+                    stream.recycle(item);
+                    emit frameProcessed(QString::number(++(*counter)) + "/" + QString::number(_collection.totalFrames()));
+                }
             });
         }
 
@@ -54,15 +83,23 @@ void _StackThread::run() {
 
         // Save current result
         cv::Mat result = _stacker.average();
-        result.convertTo(result, CV_16UC3, 65535.0 / 255.0);
 
         QString parameters = QString("%1-%2-%3")
             .arg(_percentages[i])
             .arg(_config.aps ? "local-" + QString::number(_config.aps->size()) : "global")
             .arg(QDateTime::currentDateTime().toString("dd-MM-yyyy-HH-mm-ss"));
 
-        std::string filePath = _outputDir + "/proxima-stacked" + parameters.toStdString() + ".tif";
-        cv::imwrite(filePath, result, {cv::IMWRITE_TIFF_COMPRESSION, 1});
+        std::string filePath = _outputDir + "/proxima-stacked" + parameters.toStdString();
+        if (_outputFormat == OutputFormat::Fits32) {
+            // Accumulators work in the 8-bit range, FITS float data is [0, 1]
+            filePath += ".fits";
+            FitsFile::write(QString::fromStdString(filePath), result, 1.0 / 255.0);
+        }
+        else {
+            filePath += ".tif";
+            result.convertTo(result, CV_16U, 65535.0 / 255.0);
+            cv::imwrite(filePath, result, {cv::IMWRITE_TIFF_COMPRESSION, 1});
+        }
 
         paths[i] = filePath;
     }
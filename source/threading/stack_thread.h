@@ -5,6 +5,12 @@
 #include "data/media_collection.h"
 #include "stacking/stacker.h"
 
+// Stacked image file formats
+enum class OutputFormat {
+    Tiff16, // 16-bit TIFF
+    Fits32  // 32-bit float FITS, keeps the accumulators' full precision
+};
+
 class _StackThread : public Thread {
     Q_OBJECT
 
@@ -13,8 +19,9 @@ public:
         MediaCollection &collection,
         _StackConfig &config,
         std::array<int, 4> &percentages,
-        std::vector<std::pair<int, double>> &frameQualities,
+        std::vector<double> &scores,
         std::string &outputDir,
+        OutputFormat &outputFormat,
         QObject *parent = nullptr
     );
 
@@ -30,8 +37,10 @@ private:
     MediaCollection &_collection;
     _StackConfig &_config;
     std::array<int, 4> &_percentages;
-    std::vector<std::pair<int, double>> &_frameQualities;
+    // Quality of every frame
+    std::vector<double> &_scores;
     std::string &_outputDir;
+    OutputFormat &_outputFormat;
 
     Stacker _stacker;
 };
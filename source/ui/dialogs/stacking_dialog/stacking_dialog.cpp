@@ -10,14 +10,21 @@
 StackingDialog::StackingDialog(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::StackingDialog)
-    , _analyzingThread(_files, _frameQualities)
-    , _stackThread(_files, _config, _percentages, _frameQualities, _outputDir)
+    , _analyzingThread(_files, _metrics, _scores, _analyzeConfig)
+    , _stackThread(_files, _config, _percentages, _stackScores, _outputDir, _outputFormat)
 {
     ui->setupUi(this);
     this->setWindowTitle("Stacking (Proxima)");
 
     connect(ui->analyzeFramesPushButton, &QPushButton::clicked, this, &StackingDialog::_analyzeFiles);
 
+    for (const auto &metric : QualityMetrics::registry()) {
+        ui->qualityMetricComboBox->addItem(metric.name);
+        ui->qualityMetricComboBox->setItemData(ui->qualityMetricComboBox->count() - 1, metric.description, Qt::ToolTipRole);
+    }
+
+    connect(ui->qualityMetricComboBox, &QComboBox::currentIndexChanged, this, &StackingDialog::_sortFrames);
+
     connect(ui->localAlignmentCheckBox, &QCheckBox::checkStateChanged, this, [this](Qt::CheckState state) {
         ui->alignmentOptionsFrame->setEnabled(state == Qt::Checked);
     });
@@ -26,24 +33,37 @@ StackingDialog::StackingDialog(QWidget *parent)
         ui->analyzingProgressEdit->setText(QString::number(current) + "/" + QString::number(_files.totalFrames()));
     });
 
+    connect(&_analyzingThread, &AnalyzeThread::rankingUpdated, this, [this](const std::vector<std::pair<int, double>> &ranking) {
+        // Queued before the analysis was stopped or finished
+        if (!_analyzingThread.isRunning()) {
+            return;
+        }
+
+        // Stacking can be set up, and started, from the provisional ranking
+        _showRanking(ranking);
+        _updateOutputDimensions();
+        _enableStackingOptions(true);
+    });
+
     connect(&_analyzingThread, &AnalyzeThread::finished, this, [this]() {
         ui->analyzingProgressEdit->setText("Finished!");
 
-        // Extract only indices from the <index, quality> vector
-        std::vector<int> map;
-        map.reserve(_frameQualities.size());
-        for (const auto &[id, quality] : _frameQualities) {
-            map.push_back(id);
+        // Show measured costs next to the metrics' descriptions. Results loaded
+        // from sidecars measure nothing, the last costs shown stay.
+        const auto &registry = QualityMetrics::registry();
+        for (int i = 0; i < _metrics.selected().size() && _metrics.evaluatedFrames() > 0; ++i) {
+            int metric = _metrics.selected()[i];
+            QString cost = QString::number(_metrics.milliseconds(i), 'f', 2);
+            ui->qualityMetricComboBox->setItemData(metric, registry[metric].description + " (" + cost + " ms per frame)", Qt::ToolTipRole);
         }
 
         _updateOutputDimensions();
 
         // Enable UI
         _enableStackingOptions(true);
-        this->setEnabled(true);
+        ui->analyzeGroupBox->setEnabled(true);
 
-        // Show sorted frames in main window
-        emit analyzeFinished(&_files, map);
+        _sortFrames(ui->qualityMetricComboBox->currentIndex());
     });
 
     connect(ui->stackPushButton, &QPushButton::clicked, this, &StackingDialog::_stack);
@@ -109,15 +129,71 @@ void StackingDialog::_analyzeFiles() {
     }
 
     _frameQualities.clear();
-    _frameQualities.resize(_files.totalFrames());
+    _rankedSlot = 0;
+
+    // The sorting metric comes first, it is the one frames are cached by
+    int sortBy = ui->qualityMetricComboBox->currentIndex();
+    std::vector<int> metrics{sortBy};
+    if (ui->allMetricsCheckBox->isChecked()) {
+        for (int i = 0; i < QualityMetrics::registry().size(); ++i) {
+            if (i != sortBy) {
+                metrics.push_back(i);
+            }
+        }
+    }
+    _metrics.select(metrics);
 
-    // Block UI while processing
+    _analyzeConfig.objectRegion = ui->objectRegionCheckBox->isChecked();
+    _analyzeConfig.progressive = ui->progressiveCheckBox->isChecked();
+
+    // Block UI while processing, stacking options come back with the first ranking
     _enableStackingOptions(false);
-    this->setEnabled(false);
+    ui->analyzeGroupBox->setEnabled(false);
 
     _analyzingThread.start();
 }
 
+//
+// Sorts analyzed frames by quality 'metric' and shows them in that order.
+//
+// Only metrics evaluated by the last analysis are available without analyzing again.
+//
+void StackingDialog::_sortFrames(int metric) {
+    // The dialog is disabled while analyzing, scores are complete here
+    if (_scores.empty()) {
+        return;
+    }
+
+    const auto &selected = _metrics.selected();
+    auto it = std::find(selected.begin(), selected.end(), metric);
+    if (it == selected.end()) {
+        ui->analyzingProgressEdit->setText("Analyze again to sort by this metric");
+        return;
+    }
+
+    // An analysis stopped early leaves frames unscored
+    _rankedSlot = static_cast<int>(it - selected.begin());
+    _showRanking(QualityMetrics::rank(QualityMetrics::interpolate(_scores[_rankedSlot])));
+    ui->analyzingProgressEdit->setText("Finished!");
+}
+
+//
+// Makes 'ranking' the one stacking uses, and shows frames in that order.
+//
+void StackingDialog::_showRanking(const std::vector<std::pair<int, double>> &ranking) {
+    _frameQualities = ranking;
+
+    // Extract only indices from the <index, quality> vector
+    std::vector<int> map;
+    map.reserve(_frameQualities.size());
+    for (const auto &[id, quality] : _frameQualities) {
+        map.push_back(id);
+    }
+
+    // Show sorted frames in main window
+    emit analyzeFinished(&_files, map);
+}
+
 void StackingDialog::_enableStackingOptions(bool flag) {
     ui->alignmentGroupBox->setEnabled(flag);
     ui->optionsGroupBox->setEnabled(flag);
@@ -144,6 +220,13 @@ void StackingDialog::_stack() {
 
     _outputDir = path.toStdString();
 
+    // A progressive analysis still refining: stack with the current ranking
+    if (_analyzingThread.isRunning()) {
+        _analyzingThread.stop();
+        ui->analyzingProgressEdit->setText("Stopped, ranking is approximate");
+        ui->analyzeGroupBox->setEnabled(true);
+    }
+
     _collectConfig();
 
     _stackThread.start();
@@ -159,6 +242,16 @@ void StackingDialog::_collectConfig() {
         _percentages[i] = percentageSpinBoxes[i]->value();
     }
 
+    // Frames are picked by the metric they are ranked by. An analysis stopped
+    // early leaves frames unscored, their scores are interpolated.
+    _stackScores = QualityMetrics::interpolate(_scores[_rankedSlot]);
+
+    _outputFormat = ui->outputFormatComboBox->currentIndex() == 1 ? OutputFormat::Fits32 : OutputFormat::Tiff16;
+    _config.debayer = ui->debayerComboBox->currentIndex() == 1 ? Bayer::Method::EdgeAware : Bayer::Method::Bilinear;
+    _config.globalAlignment = ui->pyramidAlignmentCheckBox->isChecked() ? GlobalAlignment::Pyramid : GlobalAlignment::FullFrame;
+    // Combo box items are in the order of the enum
+    _config.localAlignment = static_cast<LocalAlignment>(ui->apMatchingComboBox->currentIndex());
+
     if (ui->upsampleCheckBox->isChecked()) {
         _config.upsample = ui->upsampleFactorSpinBox->value();
     }
@@ -186,7 +279,8 @@ void StackingDialog::_estimateAlignmentPoints() {
     }
 
     cv::Mat reference = _files.matAtFrame(_frameQualities[0].first);
-    reference = Frame::centerObject(reference, reference.cols, reference.rows);
+    // Only read here, no need for a copy
+    reference = Frame::centerObject(reference, reference.cols, reference.rows, true);
 
     int apSize = ui->apSizeSpinBox->value();
     AlignmentPointSet::Placement placement = ui->featureBasedApsCheckBox->isChecked()
@@ -199,6 +293,9 @@ void StackingDialog::_estimateAlignmentPoints() {
 void StackingDialog::_updateModifyingFunction() {
     _modifyingFunction = [this](cv::Mat &mat) -> void {
         mat = Frame::centerObject(mat, mat.rows, mat.cols);
+        if (mat.channels() == 1) {
+            cv::cvtColor(mat, mat, cv::COLOR_GRAY2BGR);
+        }
         for (const auto &ap : _aps) {
             cv::Rect rect = ap.rect();
             rect &= cv::Rect{0, 0, mat.cols, mat.rows};
@@ -40,6 +40,14 @@ private:
     void _enableStackingOptions(bool flag);
     std::vector<std::pair<int, double>> _frameQualities;
 
+    QualityMetrics _metrics;
+    AnalyzeConfig _analyzeConfig;
+    std::vector<std::vector<double>> _scores;
+    // Selected metric slot the frames are ranked by
+    int _rankedSlot = 0;
+    void _sortFrames(int metric);
+    void _showRanking(const std::vector<std::pair<int, double>> &ranking);
+
     void _updateOutputDimensions();
 
     AlignmentPointSet _aps;
@@ -50,7 +58,9 @@ private:
     _StackThread _stackThread;
     _StackConfig _config;
     std::array<int, 4> _percentages;
+    std::vector<double> _stackScores;
     std::string _outputDir;
+    OutputFormat _outputFormat = OutputFormat::Tiff16;
     void _stack();
     void _collectConfig();
 
@@ -67,7 +67,9 @@ void MediaViewer::_showFrame(int frame) {
         mat = std::get<MediaCollection>(_source).matAtFrame(mapped);
     }
 
+    // Frames may be views into shared (mapped) memory, never modify them in place
     if (_func) {
+        mat = mat.clone();
         _func(mat);
     }
 
@@ -1,7 +1,9 @@
 #include "main_window.h"
 #include "ui_main_window.h"
 #include <QFileDialog>
+#include <QSettings>
 #include "stacking_dialog/stacking_dialog.h"
+#include "data/frame_cache.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -19,6 +21,11 @@ MainWindow::~MainWindow() {
 
 void MainWindow::_setupUI() {
     ui->mediaViewer->setMinimumSize(300, 300);
+
+    // Memory available for decoded frames shared by the viewer, analysis and stacking
+    QSettings settings;
+    size_t cacheBudget = settings.value("cache/frame-budget-mb", 1024).toULongLong();
+    FrameCache::shared().setBudget(cacheBudget * 1024 * 1024);
 }
 
 void MainWindow::_connectUI() {
@@ -28,10 +35,25 @@ void MainWindow::_connectUI() {
         if (files.isEmpty()) {
             return;
         }
+        std::vector<std::string> paths;
         for (const auto &file : files) {
-            ui->workspace->addItem(file.toStdString());
+            paths.push_back(file.toStdString());
+        }
+        ui->workspace->addItems(paths);
+    });
+
+    // 'Add image sequence' push button
+    connect(ui->addSequencePushButton, &QPushButton::clicked, this, [this]() {
+        const QString directory = QFileDialog::getExistingDirectory(this, "Select Sequence Folder", QDir::homePath());
+        if (directory.isEmpty()) {
+            return;
         }
-        ui->totalFilesEdit->setText(QString::number(ui->workspace->itemCount()));
+        ui->workspace->addItems({directory.toStdString()});
+    });
+
+    // Items are added in the background, as their files are probed
+    connect(ui->workspace, &Workspace::itemCountChanged, this, [this](int count) {
+        ui->totalFilesEdit->setText(QString::number(count));
     });
 
     // 'Clear workspace' push button
@@ -93,9 +115,7 @@ StackingDialog *MainWindow::_initializeStackingDialog() {
         if (output.empty()) {
             return;
         }
-        for (const auto &file : output) {
-            ui->workspace->addItem(file);
-        }
+        ui->workspace->addItems(output);
     });
 
     return stackingDialog;
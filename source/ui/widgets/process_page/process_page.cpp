@@ -1,10 +1,14 @@
 #include "process_page.h"
 #include "ui_process_page.h"
-#include <QFileDialog>
+#include <QDateTime>
 #include <QDesktopServices>
+#include <QDir>
+#include <QFileDialog>
+#include <QFileInfo>
 #include "deconvolution_dialog/deconvolution_dialog.h"
 #include "rgb_align_dialog/rgb_align_dialog.h"
 #include "data/media_file.h"
+#include "data/fits_file.h"
 
 ProcessPage::ProcessPage(QWidget *parent)
     : QWidget(parent)
@@ -26,7 +30,7 @@ void ProcessPage::selectFile() {
         this,
         "Open Image",
         "",
-        "Images (*.png *.jpg *.jpeg *.tif *.tiff)"
+        "Images (*.png *.jpg *.jpeg *.tif *.tiff *.fits *.fit *.fts)"
     );
 
     if (file.isEmpty()) {
@@ -43,17 +47,29 @@ void ProcessPage::selectFile() {
 }
 
 void ProcessPage::saveFile() {
-    QString outputDir = QFileDialog::getExistingDirectory();
-    if (outputDir.isEmpty()) {
+    QString defaultName = QDir::homePath() + "/proxima-processed-" + QDateTime::currentDateTime().toString("dd-MM-yyyy-HH-mm") + ".tif";
+    QString filename = QFileDialog::getSaveFileName(
+        this,
+        "Save Image",
+        defaultName,
+        "TIFF 16-bit (*.tif *.tiff);;FITS 32-bit float (*.fits *.fit)"
+    );
+
+    if (filename.isEmpty()) {
         return;
     }
 
-    QString filename = outputDir + "/proxima-processed-" + QDateTime::currentDateTime().toString("dd-MM-yyyy-HH-mm") + ".tif";
     cv::Mat result = processor.mat();
-    result.convertTo(result, CV_16UC3, 65535.0);
-    cv::imwrite(filename.toStdString(), result, {cv::IMWRITE_TIFF_COMPRESSION, 1});
+    if (filename.endsWith(".fits", Qt::CaseInsensitive) || filename.endsWith(".fit", Qt::CaseInsensitive)) {
+        // Processed data is already [0, 1] float, written without conversion
+        FitsFile::write(filename, result);
+    }
+    else {
+        result.convertTo(result, CV_16UC3, 65535.0);
+        cv::imwrite(filename.toStdString(), result, {cv::IMWRITE_TIFF_COMPRESSION, 1});
+    }
 
-    QDesktopServices::openUrl(QUrl::fromLocalFile(outputDir));
+    QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(filename).absolutePath()));
 }
 
 void ProcessPage::displayProcessed() {
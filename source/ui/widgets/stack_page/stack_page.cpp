@@ -12,10 +12,14 @@ QString fileFilters();
 StackPage::StackPage(QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::StackPage)
-    , sortingThread(manager, config.sorted)
+    , analyzingThread(manager, metrics, scores, analyzeConfig)
     // , stackingThread(manager, config, percentages, outputDir)
 {
     ui->setupUi(this);
+
+    // Nothing here uses provisional rankings
+    analyzeConfig.progressive = false;
+
     connectUI();
     loadSettings();
 }
@@ -238,16 +242,17 @@ void StackPage::connectUI() {
     });
 
     // Push buttons
-    connect(ui->analyzeFramesPushButton, &QPushButton::clicked, this, [this]() { sortingThread.start(); });
+    connect(ui->analyzeFramesPushButton, &QPushButton::clicked, this, [this]() { analyzingThread.start(); });
     connect(ui->selectFilesPushButton, &QPushButton::clicked, this, &StackPage::selectFiles);
     connect(ui->stackPushButton, &QPushButton::clicked, this, &StackPage::stack);
 
-    // Sorting thread connections
-    connect(&sortingThread, &SortThread::progressUpdated, this, [this](int current) {
+    // Analyzing thread connections
+    connect(&analyzingThread, &AnalyzeThread::progressUpdated, this, [this](int current) {
         QString status = QString("%1/%2").arg(current).arg(manager.totalFrames());
         ui->analyzingProgressEdit->setText(status);
     });
-    connect(&sortingThread, &SortThread::finished, this, [this]() {
+    connect(&analyzingThread, &AnalyzeThread::finished, this, [this]() {
+        config.sorted = QualityMetrics::rank(scores.front());
         estimateAPGrid();
         displayFrame(0);
         enableConfigEdit();
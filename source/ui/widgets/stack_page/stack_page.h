@@ -4,7 +4,7 @@
 #include <QWidget>
 #include "components/display.h"
 #include "data/media_collection.h"
-#include "threads/sort_thread.h"
+#include "threading/analyze_thread.h"
 #include "threads/stack_thread.h"
 
 namespace Ui {
@@ -44,7 +44,10 @@ private:
     void initializeConfig();
 
     // Separate threads to keep the UI responsive
-    SortThread sortingThread;
+    QualityMetrics metrics;
+    std::vector<std::vector<double>> scores;
+    AnalyzeConfig analyzeConfig;
+    AnalyzeThread analyzingThread;
     // StackThread stackingThread;
 
     // Needed to initialize 'stackingThread'
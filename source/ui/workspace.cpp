@@ -2,10 +2,13 @@
 #include <QHBoxLayout>
 #include <QGridLayout>
 #include <QScrollArea>
-#include <QFileInfo>
+#include <thread>
+#include "asio/post.hpp"
 
 Workspace::Workspace(QWidget *parent)
     : QWidget(parent)
+    // Opening files is mostly I/O, and video probing decodes with threads of its own
+    , _probePool(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 2))
 {
     auto mainLayout = new QVBoxLayout(this);
     mainLayout->setContentsMargins(0, 0, 0, 0);
@@ -26,34 +29,87 @@ Workspace::Workspace(QWidget *parent)
     mainLayout->addWidget(scrollArea);
 }
 
-bool Workspace::addItem(const std::string &path) {
-    MediaFile file(QString::fromStdString(path));
-    if (!file.isValid()) {
-        return false;
+Workspace::~Workspace() {
+    // Drop queued probes and wait for the running ones
+    _probePool.stop();
+    _probePool.join();
+}
+
+//
+// Adds media files at 'paths' to the workspace without blocking the GUI.
+//
+// Files are opened and their thumbnails decoded on a background pool.
+// Items appear as soon as their file is ready, in the order of 'paths'.
+// Invalid files and files already in the workspace are skipped.
+//
+void Workspace::addItems(const std::vector<std::string> &paths) {
+    for (const auto &path : paths) {
+        if (_mediaFiles.contains(path) || !_pendingPaths.insert(path).second) {
+            continue;
+        }
+
+        int sequence = _nextSequence++;
+        int generation = _generation;
+
+        asio::post(_probePool, [this, path, sequence, generation]() {
+            auto file = std::make_shared<MediaFile>(QString::fromStdString(path));
+
+            // Thumbnails are shown 100 px high, keep some margin for high-DPI screens
+            constexpr int thumbnailHeight = 200;
+            cv::Mat thumbnail;
+            if (file->isValid()) {
+                thumbnail = file->thumbnail(thumbnailHeight);
+            }
+
+            QMetaObject::invokeMethod(this, [this, path, file, thumbnail, sequence, generation]() {
+                // The workspace was cleared while the file was being probed
+                if (generation != _generation) {
+                    return;
+                }
+
+                _pendingPaths.erase(path);
+                if (file->isValid()) {
+                    _addProbed(file, thumbnail, sequence);
+                }
+            }, Qt::QueuedConnection);
+        });
     }
+}
 
-    auto [it, inserted] = _mediaFiles.emplace(path, std::move(file));
+void Workspace::_addProbed(std::shared_ptr<MediaFile> file, const cv::Mat &thumbnail, int sequence) {
+    auto [it, inserted] = _mediaFiles.emplace(file->path(), std::move(file));
     if (!inserted) {
-        return false;
+        return;
     }
 
-    auto *item = new _WorkspaceItem(&it->second, this);
-    _workspaceItems.emplace_back(item);
+    auto *item = new _WorkspaceItem(it->second.get(), thumbnail, sequence, this);
 
-    _containerLayout->addWidget(item);
+    // Keep items in the order they were requested in
+    auto position = std::upper_bound(_workspaceItems.begin(), _workspaceItems.end(), sequence,
+        [](int value, const _WorkspaceItem *other) {
+            return value < other->sequence();
+        });
+    int index = static_cast<int>(position - _workspaceItems.begin());
+    _workspaceItems.insert(position, item);
+
+    _containerLayout->insertWidget(index, item);
     _containerWidget->update();
 
     connect(item, &_WorkspaceItem::clicked, this, [this](const std::string &filePath) {
-        emit itemClicked(&_mediaFiles.at(filePath));
+        emit itemClicked(_mediaFiles.at(filePath).get());
     });
     connect(item, &_WorkspaceItem::checked, this, [this](const std::string &filePath, bool flag) {
-        emit itemChecked(&_mediaFiles.at(filePath), flag);
+        emit itemChecked(_mediaFiles.at(filePath).get(), flag);
     });
 
-    return true;
+    emit itemCountChanged(itemCount());
 }
 
 void Workspace::clear() {
+    // Results of probes still running are discarded
+    ++_generation;
+    _pendingPaths.clear();
+
     for (auto &itemPtr : _workspaceItems) {
         _containerLayout->removeWidget(itemPtr);
         itemPtr->deleteLater();
@@ -75,9 +131,10 @@ void Workspace::resetMultipleSelection() {
     }
 }
 
-Workspace::_WorkspaceItem::_WorkspaceItem(MediaFile *file, QWidget *parent)
+Workspace::_WorkspaceItem::_WorkspaceItem(MediaFile *file, const cv::Mat &thumbnail, int sequence, QWidget *parent)
     : QFrame(parent)
     , _filePath(file->path())
+    , _sequence(sequence)
 {
     setFixedWidth(288);
 
@@ -85,14 +142,13 @@ Workspace::_WorkspaceItem::_WorkspaceItem(MediaFile *file, QWidget *parent)
     _display->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
     _display->setMinimumHeight(100);
     _display->setMaximumHeight(100);
-    _display->show(file->matAtFrame(0), Qt::KeepAspectRatioByExpanding);
+    _display->show(thumbnail, Qt::KeepAspectRatioByExpanding);
 
     _fileNameLabel = new QLabel(this);
     _fileNameLabel->setText(QString::fromStdString(file->filename() + file->extension()));
     _fileNameLabel->setAlignment(Qt::AlignCenter);
 
-    QFileInfo fileInfo(QString::fromStdString(file->path()));
-    qint64 size = fileInfo.size();
+    qint64 size = file->size();
     QString sizeText;
     if (size < 1024) {
         sizeText = QString::number(size) + " bytes";
@@ -5,8 +5,10 @@
 #include <QLabel>
 #include <QVBoxLayout>
 #include <QCheckBox>
+#include <set>
 #include "data/media_file.h"
 #include "components/display.h"
+#include "asio/thread_pool.hpp"
 
 // Represents the whole workspace
 class Workspace : public QWidget {
@@ -14,7 +16,8 @@ class Workspace : public QWidget {
 
 public:
     explicit Workspace(QWidget *parent = nullptr);
-    bool addItem(const std::string &path);
+    ~Workspace();
+    void addItems(const std::vector<std::string> &paths);
     int itemCount() { return static_cast<int>(_workspaceItems.size()); }
     void clear();
     void enableMultipleSelection(bool flag);
@@ -23,11 +26,19 @@ public:
 signals:
     void itemClicked(MediaFile *);
     void itemChecked(MediaFile *, bool flag);
+    void itemCountChanged(int count);
 
 private:
     class _WorkspaceItem;
     std::vector<_WorkspaceItem *> _workspaceItems;
-    std::map<std::string, MediaFile> _mediaFiles;
+    std::map<std::string, std::shared_ptr<MediaFile>> _mediaFiles;
+
+    // Files are probed in the background and added as they become ready
+    asio::thread_pool _probePool;
+    std::set<std::string> _pendingPaths;
+    int _nextSequence = 0;
+    int _generation = 0;
+    void _addProbed(std::shared_ptr<MediaFile> file, const cv::Mat &thumbnail, int sequence);
 
     QWidget *_containerWidget;
     QVBoxLayout *_containerLayout;
@@ -38,7 +49,8 @@ class Workspace::_WorkspaceItem : public QFrame {
     Q_OBJECT
 
 public:
-    explicit _WorkspaceItem(MediaFile *file, QWidget *parent = nullptr);
+    _WorkspaceItem(MediaFile *file, const cv::Mat &thumbnail, int sequence, QWidget *parent = nullptr);
+    int sequence() const { return _sequence; }
     void showCheckBox(bool flag) { _checkBox->setHidden(!flag); }
     void resetCheckBox() { _checkBox->setCheckState(Qt::Unchecked); }
 
@@ -51,6 +63,7 @@ protected:
 
 private:
     const std::string _filePath;
+    const int _sequence;
     Display *_display;
     QLabel *_fileNameLabel;
     QLabel *_framesLabel;